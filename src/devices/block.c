@@ -1,8 +1,23 @@
 #include "devices/block.h"
+#include <round.h>
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* Requests are dispatched from each device's queue in C-LOOK
+   order: the one at or after the sector that followed the
+   previous dispatch, or failing that the lowest-numbered one.
+   Requests in the same class and direction that follow it
+   directly on disk are merged with it into a single call to the
+   driver, up to these limits. */
+#define MERGE_MAX 16            /* Most requests in one dispatch. */
+#define MERGE_IOV_MAX 64        /* Most buffers in one dispatch. */
+
+/* Background requests are dispatched anyway after waiting
+   through this many dispatches of foreground requests. */
+#define STARVE_MAX 8
 
 /* List of all block devices. */
 static struct list all_blocks = LIST_INITIALIZER (all_blocks);
@@ -11,6 +26,31 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+static void dispatch (struct work *);
+
+/* Returns the number of CPU cycles since the CPU was reset. */
+static inline uint64_t
+read_tsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the bucket in which value X falls in a log-scale
+   histogram with BUCKET_CNT buckets. */
+static int
+log_bucket (uint64_t x, int bucket_cnt) 
+{
+  int bucket = 0;
+
+  while (x > 1 && bucket < bucket_cnt - 1)
+    {
+      x >>= 1;
+      bucket++;
+    }
+  return bucket;
+}
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -103,9 +143,8 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  struct block_iovec iov = {buffer, 1};
+  block_readv (block, sector, &iov, 1);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -116,10 +155,295 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  struct block_iovec iov = {(void *) buffer, 1};
+  block_writev (block, sector, &iov, 1);
+}
+
+/* Returns the total number of sectors in the IOV_CNT buffers in
+   IOV. */
+block_sector_t
+block_iovec_sectors (const struct block_iovec *iov, size_t iov_cnt) 
+{
+  block_sector_t sector_cnt = 0;
+  size_t i;
+
+  for (i = 0; i < iov_cnt; i++)
+    sector_cnt += iov[i].sector_cnt;
+  return sector_cnt;
+}
+
+/* Reads consecutive sectors of BLOCK, starting at SECTOR, into
+   the IOV_CNT buffers in IOV, filling each buffer in turn, as a
+   single request.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_readv (struct block *block, block_sector_t sector,
+             const struct block_iovec *iov, size_t iov_cnt)
+{
+  struct block_request r;
+
+  block_request_init (&r, false, sector, iov, iov_cnt);
+  block_submit (block, &r);
+  block_wait (&r);
+}
+
+/* Writes consecutive sectors of BLOCK, starting at SECTOR, from
+   the IOV_CNT buffers in IOV, taking each buffer in turn, as a
+   single request.  Returns after the block device has
+   acknowledged receiving all the data.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_writev (struct block *block, block_sector_t sector,
+              const struct block_iovec *iov, size_t iov_cnt)
+{
+  struct block_request r;
+
+  block_request_init (&r, true, sector, iov, iov_cnt);
+  block_submit (block, &r);
+  block_wait (&r);
+}
+
+/* Initializes R as a foreground request, with no completion
+   function, to read (or write, if WRITE is true) consecutive
+   sectors starting at SECTOR into (or from) the IOV_CNT buffers
+   in IOV. */
+void
+block_request_init (struct block_request *r, bool write,
+                    block_sector_t sector, const struct block_iovec *iov,
+                    size_t iov_cnt) 
+{
+  r->write = write;
+  r->class = BLOCK_FOREGROUND;
+  r->sector = sector;
+  r->sector_cnt = block_iovec_sectors (iov, iov_cnt);
+  r->iov = iov;
+  r->iov_cnt = iov_cnt;
+  r->done = NULL;
+  r->aux = NULL;
+  sema_init (&r->completed, 0);
+}
+
+/* Returns true if request A_ starts at a lower sector than
+   request B_. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED) 
+{
+  const struct block_request *a = list_entry (a_, struct block_request,
+                                              elem);
+  const struct block_request *b = list_entry (b_, struct block_request,
+                                              elem);
+  return a->sector < b->sector;
+}
+
+/* Calls R's completion function, or wakes up its waiter. */
+static void
+complete (struct block_request *r) 
+{
+  if (r->done != NULL)
+    r->done (r);
+  else
+    sema_up (&r->completed);
+}
+
+/* Queues request R for BLOCK and returns without waiting for it
+   to be carried out. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  struct block *q = block->queue_block;
+
+  if (r->sector_cnt == 0)
+    {
+      complete (r);
+      return;
+    }
+  check_sector (block, r->sector);
+  check_sector (block, r->sector + r->sector_cnt - 1);
+  ASSERT (!r->write || block->type != BLOCK_FOREIGN);
+  ASSERT (q->wq != NULL);
+
+  lock_acquire (&q->queue_lock);
+  if (r->write)
+    {
+      block->write_cnt += r->sector_cnt;
+      block->write_req_cnt++;
+    }
+  else
+    {
+      block->read_cnt += r->sector_cnt;
+      block->read_req_cnt++;
+    }
+  block->region_cnt[(uint64_t) r->sector * BLOCK_REGION_CNT
+                    / block->size]++;
+  if (++q->depth > q->max_depth)
+    q->max_depth = q->depth;
+  q->depth_cnt[log_bucket (q->depth, BLOCK_DEPTH_BUCKETS)]++;
+
+  r->block = block;
+  r->sector += block->queue_ofs;
+  r->submit_time = read_tsc ();
+  list_insert_ordered (&q->queue[r->class], &r->elem, request_less, NULL);
+  lock_release (&q->queue_lock);
+
+  workqueue_queue (q->wq, &q->dispatch_work);
+}
+
+/* Waits for request R, which must not have a completion
+   function, to be carried out. */
+void
+block_wait (struct block_request *r) 
+{
+  ASSERT (r->done == NULL);
+  sema_down (&r->completed);
+}
+
+/* Removes the next requests to dispatch from Q's queue and
+   stores them in BATCH, which must have room for MERGE_MAX
+   elements, in sector order.  Returns the number of requests
+   stored, which is 0 if the queue is empty. */
+static size_t
+next_batch (struct block *q, struct block_request *batch[])
+{
+  struct list *fg = &q->queue[BLOCK_FOREGROUND];
+  struct list *bg = &q->queue[BLOCK_BACKGROUND];
+  struct list *l;
+  struct list_elem *e;
+  struct block_request *first;
+  block_sector_t end;
+  size_t cnt, iov_cnt;
+
+  ASSERT (lock_held_by_current_thread (&q->queue_lock));
+
+  /* Choose a class. */
+  if (!list_empty (fg) && (list_empty (bg) || q->starve_cnt < STARVE_MAX))
+    {
+      l = fg;
+      if (!list_empty (bg))
+        q->starve_cnt++;
+    }
+  else if (!list_empty (bg))
+    {
+      l = bg;
+      q->starve_cnt = 0;
+    }
+  else
+    return 0;
+
+  /* Take the first request at or after the head, wrapping
+     around to the start. */
+  for (e = list_begin (l); e != list_end (l); e = list_next (e))
+    if (list_entry (e, struct block_request, elem)->sector >= q->head)
+      break;
+  if (e == list_end (l))
+    e = list_begin (l);
+  first = list_entry (e, struct block_request, elem);
+  e = list_remove (e);
+  batch[0] = first;
+  cnt = 1;
+  end = first->sector + first->sector_cnt;
+  iov_cnt = first->iov_cnt;
+
+  /* Merge the requests that follow it directly. */
+  while (cnt < MERGE_MAX && e != list_end (l))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (r->sector != end || r->write != first->write
+          || iov_cnt + r->iov_cnt > MERGE_IOV_MAX)
+        break;
+      e = list_remove (e);
+      batch[cnt++] = r;
+      end += r->sector_cnt;
+      iov_cnt += r->iov_cnt;
+    }
+
+  q->head = end;
+  return cnt;
+}
+
+/* Transfers consecutive sectors of BLOCK, starting at SECTOR, to
+   or from the IOV_CNT buffers in IOV by calling its driver.
+   Writes if WRITE is true, otherwise reads. */
+static void
+transfer (struct block *block, bool write, block_sector_t sector,
+          const struct block_iovec *iov, size_t iov_cnt) 
+{
+  size_t i, j;
+
+  if (write && block->ops->writev != NULL)
+    block->ops->writev (block->aux, sector, iov, iov_cnt);
+  else if (!write && block->ops->readv != NULL)
+    block->ops->readv (block->aux, sector, iov, iov_cnt);
+  else
+    for (i = 0; i < iov_cnt; i++)
+      for (j = 0; j < iov[i].sector_cnt; j++)
+        {
+          uint8_t *buffer = (uint8_t *) iov[i].buffer + j * BLOCK_SECTOR_SIZE;
+          if (write)
+            block->ops->write (block->aux, sector++, buffer);
+          else
+            block->ops->read (block->aux, sector++, buffer);
+        }
+}
+
+/* Work function for a device's dispatch thread.  Carries out the
+   requests in the device's queue until it is empty. */
+static void
+dispatch (struct work *w) 
+{
+  struct block *q = work_entry (w, struct block, dispatch_work);
+  struct block_request *batch[MERGE_MAX];
+  struct block_iovec iov[MERGE_IOV_MAX];
+
+  for (;;)
+    {
+      size_t cnt, iov_cnt, i;
+      uint64_t now;
+
+      lock_acquire (&q->queue_lock);
+      cnt = next_batch (q, batch);
+      lock_release (&q->queue_lock);
+      if (cnt == 0)
+        break;
+
+      if (cnt == 1)
+        transfer (q, batch[0]->write, batch[0]->sector, batch[0]->iov,
+                  batch[0]->iov_cnt);
+      else
+        {
+          iov_cnt = 0;
+          for (i = 0; i < cnt; i++)
+            {
+              memcpy (iov + iov_cnt, batch[i]->iov,
+                      batch[i]->iov_cnt * sizeof *iov);
+              iov_cnt += batch[i]->iov_cnt;
+            }
+          transfer (q, batch[0]->write, batch[0]->sector, iov, iov_cnt);
+        }
+      q->dispatch_cnt++;
+      q->merge_cnt += cnt - 1;
+
+      /* Record latencies, before anyone waiting can reuse the
+         requests. */
+      now = read_tsc ();
+      for (i = 0; i < cnt; i++)
+        {
+          struct block_request *r = batch[i];
+          int bucket = log_bucket (now - r->submit_time,
+                                   BLOCK_LATENCY_BUCKETS);
+          r->block->latency[r->write][bucket]++;
+          if (r->block != q)
+            q->latency[r->write][bucket]++;
+        }
+      lock_acquire (&q->queue_lock);
+      q->depth -= cnt;
+      lock_release (&q->queue_lock);
+
+      for (i = 0; i < cnt; i++)
+        complete (batch[i]);
+    }
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -143,20 +467,90 @@ block_type (struct block *block)
   return block->type;
 }
 
-/* Prints statistics for each block device used for a Pintos role. */
+/* Prints the nonzero buckets of HIST, a log-scale histogram
+   with CNT buckets, as "2^BUCKET:COUNT" pairs, on a line that
+   begins with NAME and WHAT.  Prints nothing if all the buckets
+   are zero. */
+static void
+print_histogram (const char *name, const char *what,
+                 const unsigned long long hist[], int cnt) 
+{
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    if (hist[i] != 0)
+      break;
+  if (i >= cnt)
+    return;
+
+  printf ("%s %s:", name, what);
+  for (; i < cnt; i++)
+    if (hist[i] != 0)
+      printf (" 2^%d:%llu", i, hist[i]);
+  printf ("\n");
+}
+
+/* Prints BLOCK's latency histograms and, if SHOW_REGIONS, the
+   number of requests that started in each of its regions. */
+static void
+print_request_stats (struct block *block, bool show_regions) 
+{
+  int i;
+
+  print_histogram (block->name, "read latency (cycles)",
+                   block->latency[0], BLOCK_LATENCY_BUCKETS);
+  print_histogram (block->name, "write latency (cycles)",
+                   block->latency[1], BLOCK_LATENCY_BUCKETS);
+  if (show_regions && block->read_req_cnt + block->write_req_cnt > 0)
+    {
+      printf ("%s requests by region of %"PRDSNu" sectors:", block->name,
+              DIV_ROUND_UP (block->size, BLOCK_REGION_CNT));
+      for (i = 0; i < BLOCK_REGION_CNT; i++)
+        printf (" %llu", block->region_cnt[i]);
+      printf ("\n");
+    }
+}
+
+/* Prints statistics for each block device used for a Pintos role:
+   the number of sectors transferred and the number of requests
+   that transferred them, the requests' latencies, and where on
+   the device they went.  Then prints, for each request queue,
+   the number of driver calls made, the number of requests merged
+   into others along the way, how deep the queue got, and the
+   latencies of all the requests on it. */
 void
 block_print_stats (void)
 {
+  struct list_elem *e;
   int i;
 
-  for (i = 0; i < BLOCK_CNT; i++)
+  for (i = 0; i < BLOCK_ROLE_CNT; i++)
     {
       struct block *block = block_by_role[i];
       if (block != NULL)
         {
-          printf ("%s (%s): %llu reads, %llu writes\n",
+          printf ("%s (%s): %llu reads, %llu writes "
+                  "(%llu read requests, %llu write requests)\n",
                   block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
+                  block->read_cnt, block->write_cnt,
+                  block->read_req_cnt, block->write_req_cnt);
+          print_request_stats (block, true);
+        }
+    }
+
+  for (e = list_begin (&all_blocks); e != list_end (&all_blocks);
+       e = list_next (e))
+    {
+      struct block *block = list_entry (e, struct block, list_elem);
+      if (block->dispatch_cnt > 0)
+        {
+          printf ("%s: %llu dispatches, %llu requests merged, "
+                  "queue depth at most %d\n",
+                  block->name, block->dispatch_cnt, block->merge_cnt,
+                  block->max_depth);
+          print_histogram (block->name, "queue depth", block->depth_cnt,
+                           BLOCK_DEPTH_BUCKETS);
+          print_request_stats (block, false);
         }
     }
 }
@@ -165,13 +559,22 @@ block_print_stats (void)
    EXTRA_INFO is non-null, it is printed as part of a user
    message.  The block device's SIZE in sectors and its TYPE must
    be provided, as well as the it operation functions OPS, which
-   will be passed AUX in each function call. */
+   will be passed AUX in each function call.
+
+   OPS may be null for a device, such as a partition, that has
+   no driver of its own.  Such a device must be passed to
+   block_set_parent() before it is used.  Every other device gets
+   a dispatch thread for its request queue here, so that
+   submitting a request never needs to allocate memory.  Must be
+   called after workqueue_init(). */
 struct block *
 block_register (const char *name, enum block_type type,
                 const char *extra_info, block_sector_t size,
                 const struct block_operations *ops, void *aux)
 {
   struct block *block = malloc (sizeof *block);
+  int i;
+
   if (block == NULL)
     PANIC ("Failed to allocate memory for block device descriptor");
 
@@ -183,6 +586,30 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  block->read_req_cnt = 0;
+  block->write_req_cnt = 0;
+  block->queue_block = block;
+  block->queue_ofs = 0;
+  lock_init (&block->queue_lock);
+  lock_set_name (&block->queue_lock, block->name);
+  for (i = 0; i < BLOCK_CLASS_CNT; i++)
+    list_init (&block->queue[i]);
+  block->head = 0;
+  block->starve_cnt = 0;
+  block->wq = NULL;
+  if (ops != NULL)
+    {
+      block->wq = workqueue_create (block->name, PRI_DEFAULT, 1);
+      if (block->wq == NULL)
+        PANIC ("%s: failed to create dispatch thread", block->name);
+    }
+  work_init (&block->dispatch_work, dispatch);
+  block->dispatch_cnt = 0;
+  block->merge_cnt = 0;
+  memset (block->latency, 0, sizeof block->latency);
+  memset (block->region_cnt, 0, sizeof block->region_cnt);
+  block->depth = block->max_depth = 0;
+  memset (block->depth_cnt, 0, sizeof block->depth_cnt);
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -194,6 +621,20 @@ block_register (const char *name, enum block_type type,
   return block;
 }
 
+/* Makes BLOCK, which begins at sector START of device PARENT,
+   share PARENT's request queue, so that requests for all the
+   partitions of a disk are scheduled together. */
+void
+block_set_parent (struct block *block, struct block *parent,
+                  block_sector_t start)
+{
+  ASSERT (block->ops == NULL);
+  ASSERT (start + block->size <= parent->size);
+
+  block->queue_block = parent->queue_block;
+  block->queue_ofs = parent->queue_ofs + start;
+}
+
 /* Returns the block device corresponding to LIST_ELEM, or a null
    pointer if LIST_ELEM is the list end of all_blocks. */
 static struct block *
@@ -4,6 +4,8 @@
 #include <stddef.h>
 #include <inttypes.h>
 #include <list.h>
+#include "threads/synch.h"
+#include "threads/workqueue.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -23,6 +25,14 @@ typedef uint32_t block_sector_t;
 
 struct block;
 
+/* One buffer of a vectored request, which holds SECTOR_CNT
+   consecutive sectors of the request. */
+struct block_iovec
+  {
+    void *buffer;                       /* SECTOR_CNT sectors of data. */
+    size_t sector_cnt;                  /* Number of sectors. */
+  };
+
 /* Type of a block device. */
 enum block_type
   {
@@ -40,7 +50,26 @@ enum block_type
     BLOCK_CNT                    /* Number of Pintos block types. */
   };
 
+/* Request queue classes.  Background requests are dispatched
+   only when no foreground request is waiting, or when they have
+   waited too long. */
+enum block_class
+  {
+    BLOCK_FOREGROUND,           /* Someone is waiting for it. */
+    BLOCK_BACKGROUND,           /* Write-back, read-ahead, etc. */
+    BLOCK_CLASS_CNT
+  };
 
+/* Number of buckets in the log-scale histograms kept for each
+   block device.  Bucket I counts values from 2**I up to
+   2**(I + 1) - 1, with 0 counted in bucket 0 and values past the
+   last bucket in the last. */
+#define BLOCK_LATENCY_BUCKETS 40        /* Latency, in CPU cycles. */
+#define BLOCK_DEPTH_BUCKETS 8           /* Queue depth. */
+
+/* Number of equal regions each block device is divided into for
+   counting where requests go. */
+#define BLOCK_REGION_CNT 16
 
 /* A block device. */
 struct block
@@ -56,6 +85,67 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+    unsigned long long read_req_cnt;    /* Number of read requests. */
+    unsigned long long write_req_cnt;   /* Number of write requests. */
+
+    /* Requests for this device go on the queue of QUEUE_BLOCK,
+       offset by QUEUE_OFS sectors.  That is the device itself,
+       except for partitions, which share their disk's queue. */
+    struct block *queue_block;          /* Device with the queue. */
+    block_sector_t queue_ofs;           /* Our first sector in it. */
+
+    /* Request queue, if QUEUE_BLOCK is this device. */
+    struct lock queue_lock;             /* Guards the members below. */
+    struct list queue[BLOCK_CLASS_CNT]; /* Requests in sector order. */
+    block_sector_t head;                /* Sector after last dispatch. */
+    int starve_cnt;                     /* Dispatches while background
+                                           requests waited. */
+    struct workqueue *wq;               /* Dispatch thread, or null. */
+    struct work dispatch_work;          /* Dispatches the queue. */
+    unsigned long long dispatch_cnt;    /* Number of driver calls. */
+    unsigned long long merge_cnt;       /* Requests merged into others. */
+
+    /* Request statistics, kept both for the device that requests
+       were submitted to and for the device with the queue,
+       except as noted. */
+    unsigned long long latency[2][BLOCK_LATENCY_BUCKETS];
+                                        /* Reads, writes: submission to
+                                           completion. */
+    unsigned long long region_cnt[BLOCK_REGION_CNT];
+                                        /* Requests by starting sector,
+                                           submitted device only. */
+    int depth;                          /* Requests queued or in progress,
+                                           queue device only. */
+    int max_depth;                      /* Highest DEPTH. */
+    unsigned long long depth_cnt[BLOCK_DEPTH_BUCKETS];
+                                        /* DEPTH at each submission,
+                                           including the new request. */
+  };
+
+/* An asynchronous request to transfer consecutive sectors of a
+   block device to or from a list of buffers.
+
+   Set up a request with block_request_init(), adjust CLASS,
+   DONE and AUX as needed, and pass it to block_submit().  When
+   the transfer is complete, DONE is called from the device's
+   dispatch thread, or if DONE is null, block_wait() returns.
+   The request and its buffers must remain valid until then.
+   Requests whose sectors overlap may be carried out in any
+   order. */
+struct block_request
+  {
+    struct list_elem elem;              /* Element in request queue. */
+    bool write;                         /* Write, not read? */
+    enum block_class class;             /* Queue class. */
+    block_sector_t sector;              /* First sector. */
+    block_sector_t sector_cnt;          /* Number of sectors. */
+    const struct block_iovec *iov;      /* Buffers. */
+    size_t iov_cnt;                     /* Number of buffers. */
+    void (*done) (struct block_request *);  /* Completion function. */
+    void *aux;                          /* For use by DONE. */
+    struct semaphore completed;         /* Up'd if DONE is null. */
+    struct block *block;                /* Device submitted to. */
+    uint64_t submit_time;               /* CPU cycle count at submission. */
   };
 
 const char *block_type_name (enum block_type);
@@ -72,6 +162,19 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_readv (struct block *, block_sector_t,
+                  const struct block_iovec *, size_t iov_cnt);
+void block_writev (struct block *, block_sector_t,
+                   const struct block_iovec *, size_t iov_cnt);
+block_sector_t block_iovec_sectors (const struct block_iovec *,
+                                    size_t iov_cnt);
+
+/* Asynchronous requests. */
+void block_request_init (struct block_request *, bool write,
+                         block_sector_t, const struct block_iovec *,
+                         size_t iov_cnt);
+void block_submit (struct block *, struct block_request *);
+void block_wait (struct block_request *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
@@ -80,14 +183,24 @@ void block_print_stats (void);
 
 /* Lower-level interface to block device drivers. */
 
+/* READ and WRITE transfer a single sector.  READV and WRITEV,
+   which may be null, transfer a run of consecutive sectors to or
+   from a list of buffers in one request; without them, the block
+   layer breaks vectored requests into single sectors. */
 struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+    void (*readv) (void *aux, block_sector_t,
+                   const struct block_iovec *, size_t iov_cnt);
+    void (*writev) (void *aux, block_sector_t,
+                    const struct block_iovec *, size_t iov_cnt);
   };
 
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
+void block_set_parent (struct block *, struct block *parent,
+                       block_sector_t start);
 
 #endif /* devices/block.h */
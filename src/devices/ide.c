@@ -8,10 +8,19 @@
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "threads/workqueue.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].
+
+   Data is transferred by PIO, with the CPU copying each sector
+   through the data register, unless the controller is a PCI
+   bus-master IDE controller, such as the Intel PIIX that QEMU
+   and Bochs emulate, in which case the controller copies the
+   data to or from memory itself by DMA. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -33,7 +42,9 @@
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
+#define STA_DF 0x20             /* Device Fault. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +60,44 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Most sectors that a single READ SECTOR or WRITE SECTOR command
+   can transfer.  (A sector count of 0 means this many.) */
+#define MAX_SECTOR_CNT 256
+
+/* Bus-master IDE port addresses, relative to the channel's
+   base in the controller's I/O space.  See [PIIX]. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
+/* Bus-master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer into memory. */
+
+/* Bus-master Status Register bits.
+   ERROR and INTR are cleared by writing 1s to them. */
+#define BM_STA_ERROR 0x02       /* Transfer failed. */
+#define BM_STA_INTR 0x04        /* Device interrupted. */
+
+/* A physical region descriptor, which gives the controller one
+   physically contiguous region of memory to transfer.  A region
+   may not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Size in bytes, with 0 meaning 64 kB. */
+    uint16_t flags;             /* PRD_EOT or 0. */
+  };
+
+#define PRD_EOT 0x8000          /* Last descriptor in table. */
+
+/* Number of descriptors in each channel's table.  Each sector
+   of a transfer needs at most two, so a transfer is cut short
+   if its buffers are too scattered to fit. */
+#define PRD_CNT 64
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +106,7 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    bool dma;                   /* Transfer data by DMA? */
   };
 
 /* An ATA channel (aka controller).
@@ -71,6 +121,11 @@ struct channel
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
+    unsigned spurious_cnt;      /* Unexpected interrupts not yet reported. */
+    struct work spurious_work;  /* Reports unexpected interrupts. */
+
+    uint16_t bm_base;           /* Bus-master base I/O port, 0 if none. */
+    struct prd *prd;            /* PRD table, if bm_base is nonzero. */
 
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
@@ -81,11 +136,20 @@ static struct channel channels[CHANNEL_CNT];
 
 static struct block_operations ide_operations;
 
+static uint16_t find_bus_master (void);
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static block_sector_t dma_transfer (struct ata_disk *, block_sector_t,
+                                    block_sector_t cnt,
+                                    const struct block_iovec **, size_t *ofs,
+                                    bool write);
+static void pio_transfer (struct ata_disk *, block_sector_t,
+                          block_sector_t cnt, const struct block_iovec **,
+                          size_t *ofs, bool write);
+static void select_sector (struct ata_disk *, block_sector_t,
+                           block_sector_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -96,13 +160,19 @@ static void select_device (const struct ata_disk *);
 static void select_device_wait (const struct ata_disk *);
 
 static void interrupt_handler (struct intr_frame *);
+static void report_spurious (struct work *);
 
 /* Initialize the disk subsystem and detect disks. */
 void
 ide_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
+  struct prd *prd = NULL;
   size_t chan_no;
 
+  if (bm_base != 0)
+    prd = palloc_get_page (PAL_ASSERT);
+
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
     {
       struct channel *c = &channels[chan_no];
@@ -124,8 +194,21 @@ ide_init (void)
           NOT_REACHED ();
         }
       lock_init (&c->lock);
+      lock_set_name (&c->lock, c->name);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      c->spurious_cnt = 0;
+      work_init (&c->spurious_work, report_spurious);
+      if (bm_base != 0)
+        {
+          c->bm_base = bm_base + chan_no * 8;
+          c->prd = prd + chan_no * PRD_CNT;
+        }
+      else
+        {
+          c->bm_base = 0;
+          c->prd = NULL;
+        }
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +219,7 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->dma = false;
         }
 
       /* Register interrupt handler. */
@@ -155,6 +239,67 @@ ide_init (void)
     }
 }
 
+/* PCI configuration space ports. */
+#define PCI_CONFIG_ADDRESS 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+/* Returns the 32-bit PCI configuration register at offset REG
+   of function FUNC of device DEV on bus 0. */
+static uint32_t
+pci_read_config (int dev, int func, int reg) 
+{
+  outl (PCI_CONFIG_ADDRESS, 0x80000000 | (dev << 11) | (func << 8) | reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Sets the 32-bit PCI configuration register at offset REG of
+   function FUNC of device DEV on bus 0 to VALUE. */
+static void
+pci_write_config (int dev, int func, int reg, uint32_t value) 
+{
+  outl (PCI_CONFIG_ADDRESS, 0x80000000 | (dev << 11) | (func << 8) | reg);
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Looks on PCI bus 0 for an IDE controller that drives the
+   legacy channels and is capable of bus mastering, such as the
+   PIIX in a standard PC.  If it finds one, enables bus mastering
+   and returns the base of its bus-master I/O ports.  Otherwise,
+   returns 0. */
+static uint16_t
+find_bus_master (void) 
+{
+  int dev, func;
+
+  for (dev = 0; dev < 32; dev++)
+    for (func = 0; func < 8; func++)
+      {
+        uint32_t class, bar;
+
+        if ((pci_read_config (dev, func, 0x00) & 0xffff) == 0xffff)
+          continue;
+
+        /* Class 01h (mass storage), subclass 01h (IDE), with
+           programming interface bit 7 (bus master) set and bits 0
+           and 2 (native mode channels) clear. */
+        class = pci_read_config (dev, func, 0x08) >> 8;
+        if ((class & 0xffff00) != 0x010100 || (class & 0x85) != 0x80)
+          continue;
+
+        /* BAR 4 must be in I/O space. */
+        bar = pci_read_config (dev, func, 0x20);
+        if ((bar & 1) == 0 || (bar & 0xfffc) == 0)
+          continue;
+
+        /* Enable I/O space and bus mastering. */
+        pci_write_config (dev, func, 0x04,
+                          pci_read_config (dev, func, 0x04) | 0x05);
+        printf ("ide: bus-master DMA at I/O port %#x\n", bar & 0xfffc);
+        return bar & 0xfffc;
+      }
+  return 0;
+}
+
 /* Disk detection and identification. */
 
 static char *descramble_ata_string (char *, int size);
@@ -286,8 +431,13 @@ identify_ata_device (struct ata_disk *d)
   capacity = *(uint32_t *) &id[60 * 2];
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
+
+  /* Use DMA if the controller and the disk (per word 49 of its
+     identity) both support it. */
+  d->dma = c->bm_base != 0 && (*(uint16_t *) &id[49 * 2] & 0x100) != 0;
   snprintf (extra_info, sizeof extra_info,
-            "model \"%s\", serial \"%s\"", model, serial);
+            "model \"%s\", serial \"%s\"%s", model, serial,
+            d->dma ? ", DMA" : "");
 
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
@@ -337,23 +487,82 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
+/* Returns the buffer for the sector of a vectored request that
+   *IOV and *OFS designate, as the buffer in *IOV and the sector
+   within it, and advances them to the following sector. */
+static void *
+next_buffer (const struct block_iovec **iov, size_t *ofs) 
+{
+  while (*ofs >= (*iov)->sector_cnt)
+    {
+      (*iov)++;
+      *ofs = 0;
+    }
+  return (uint8_t *) (*iov)->buffer + (*ofs)++ * BLOCK_SECTOR_SIZE;
+}
+
+/* Transfers consecutive sectors of disk D, starting at SEC_NO,
+   to or from the IOV_CNT buffers in IOV, with as few commands as
+   possible.  Writes if WRITE is true, otherwise reads. */
+static void
+ide_transfer (struct ata_disk *d, block_sector_t sec_no,
+              const struct block_iovec *iov, size_t iov_cnt, bool write)
+{
+  struct channel *c = d->channel;
+  block_sector_t left = block_iovec_sectors (iov, iov_cnt);
+  size_t ofs = 0;
+
+  lock_acquire (&c->lock);
+  while (left > 0)
+    {
+      block_sector_t cnt = left < MAX_SECTOR_CNT ? left : MAX_SECTOR_CNT;
+      block_sector_t done = 0;
+
+      if (d->dma)
+        done = dma_transfer (d, sec_no, cnt, &iov, &ofs, write);
+      if (done == 0)
+        {
+          pio_transfer (d, sec_no, cnt, &iov, &ofs, write);
+          done = cnt;
+        }
+      sec_no += done;
+      left -= done;
+    }
+  lock_release (&c->lock);
+}
+
+/* Reads consecutive sectors of disk D, starting at SEC_NO, into
+   the IOV_CNT buffers in IOV.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_readv (void *d, block_sector_t sec_no, const struct block_iovec *iov,
+           size_t iov_cnt)
+{
+  ide_transfer (d, sec_no, iov, iov_cnt, false);
+}
+
+/* Writes consecutive sectors of disk D, starting at SEC_NO, from
+   the IOV_CNT buffers in IOV.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_writev (void *d, block_sector_t sec_no, const struct block_iovec *iov,
+            size_t iov_cnt)
+{
+  ide_transfer (d, sec_no, iov, iov_cnt, true);
+}
+
 /* Reads sector SEC_NO from disk D into BUFFER, which must have
    room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_read (void *d, block_sector_t sec_no, void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  lock_release (&c->lock);
+  struct block_iovec iov = {buffer, 1};
+  ide_readv (d, sec_no, &iov, 1);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -362,38 +571,171 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_write (void *d, block_sector_t sec_no, const void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+  struct block_iovec iov = {(void *) buffer, 1};
+  ide_writev (d, sec_no, &iov, 1);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_readv,
+    ide_writev
   };
-
+
+/* Fills in the PRD table of channel C to cover the CNT sectors
+   of buffers that *IOV and *OFS designate, advancing them past
+   the sectors covered.  Returns the number of sectors covered,
+   which is less than CNT if the table fills up, or 0 if some
+   buffer cannot be reached by DMA. */
+static block_sector_t
+build_prd_table (struct channel *c, block_sector_t cnt,
+                 const struct block_iovec **iov, size_t *ofs) 
+{
+  size_t prd_cnt = 0;
+  uint32_t end = 0;
+  block_sector_t i;
+
+  for (i = 0; i < cnt && prd_cnt + 2 <= PRD_CNT; i++)
+    {
+      void *buffer = next_buffer (iov, ofs);
+      uint32_t addr;
+      size_t size;
+
+      if (!is_kernel_vaddr (buffer) || ((uintptr_t) buffer & 1) != 0)
+        return 0;
+
+      /* Add the sector's memory, splitting it at a 64 kB
+         boundary, and merging it with the previous region if it
+         directly follows it within the same 64 kB. */
+      addr = vtop (buffer);
+      for (size = BLOCK_SECTOR_SIZE; size > 0; )
+        {
+          size_t chunk = 0x10000 - (addr & 0xffff);
+          if (chunk > size)
+            chunk = size;
+
+          if (prd_cnt > 0 && addr == end && (addr & 0xffff) != 0)
+            c->prd[prd_cnt - 1].size += chunk;
+          else
+            {
+              c->prd[prd_cnt].addr = addr;
+              c->prd[prd_cnt].size = chunk;
+              c->prd[prd_cnt].flags = 0;
+              prd_cnt++;
+            }
+          addr += chunk;
+          end = addr;
+          size -= chunk;
+        }
+    }
+  c->prd[prd_cnt - 1].flags = PRD_EOT;
+  return i;
+}
+
+/* Transfers up to CNT sectors of disk D, starting at SEC_NO, to
+   or from the buffers that *IOV and *OFS designate, by DMA, and
+   advances them past the sectors transferred.  Writes if WRITE
+   is true, otherwise reads.  Returns the number of sectors
+   transferred, or 0 if the buffers cannot be reached by DMA.
+   D's channel must be locked. */
+static block_sector_t
+dma_transfer (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt,
+              const struct block_iovec **iov, size_t *ofs, bool write) 
+{
+  struct channel *c = d->channel;
+  const struct block_iovec *next_iov = *iov;
+  size_t next_ofs = *ofs;
+  uint8_t bm_status, status;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  cnt = build_prd_table (c, cnt, &next_iov, &next_ofs);
+  if (cnt == 0)
+    return 0;
+  *iov = next_iov;
+  *ofs = next_ofs;
+
+  /* Set up the controller, then the disk, then start the
+     controller.  The disk interrupts once when the whole
+     transfer is done. */
+  outl (reg_bm_prdt (c), vtop (c->prd));
+  outb (reg_bm_command (c), write ? 0 : BM_CMD_READ);
+  outb (reg_bm_status (c), BM_STA_ERROR | BM_STA_INTR);
+  select_sector (d, sec_no, cnt);
+  issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (reg_bm_command (c), (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+  sema_down (&c->completion_wait);
+
+  /* Stop the controller and check for errors. */
+  outb (reg_bm_command (c), 0);
+  bm_status = inb (reg_bm_status (c));
+  outb (reg_bm_status (c), BM_STA_ERROR | BM_STA_INTR);
+  status = inb (reg_alt_status (c));
+  if ((bm_status & BM_STA_ERROR) != 0
+      || (status & (STA_ERR | STA_DF)) != 0)
+    PANIC ("%s: DMA %s failed, sector=%"PRDSNu, d->name,
+           write ? "write" : "read", sec_no);
+  return cnt;
+}
+
+/* Transfers CNT sectors of disk D, starting at SEC_NO, to or
+   from the buffers that *IOV and *OFS designate, by PIO, and
+   advances them past the sectors transferred.  Writes if WRITE
+   is true, otherwise reads.  D's channel must be locked. */
+static void
+pio_transfer (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt,
+              const struct block_iovec **iov, size_t *ofs, bool write) 
+{
+  struct channel *c = d->channel;
+  block_sector_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  select_sector (d, sec_no, cnt);
+  if (write)
+    {
+      /* The disk interrupts as it accepts each sector. */
+      issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+      for (i = 0; i < cnt; i++)
+        {
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name,
+                   sec_no + i);
+          output_sector (c, next_buffer (iov, ofs));
+          sema_down (&c->completion_wait);
+        }
+    }
+  else
+    {
+      /* The disk interrupts as each sector becomes ready. */
+      issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+      for (i = 0; i < cnt; i++)
+        {
+          sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name,
+                   sec_no + i);
+          input_sector (c, next_buffer (iov, ofs));
+        }
+    }
+}
+
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT to the disk's sector selection and
+   sector count registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt)
 {
   struct channel *c = d->channel;
 
-  ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_SECTOR_CNT);
+  ASSERT (sec_no + cnt <= (1UL << 28));
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt % MAX_SECTOR_CNT);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -502,7 +844,11 @@ select_device_wait (const struct ata_disk *d)
   wait_until_idle (d);
 }
 
-/* ATA interrupt handler. */
+/* ATA interrupt handler.
+   Only does what cannot wait: acknowledging the interrupt and
+   waking the waiting thread.  Reporting an unexpected interrupt
+   means printing to the console, which is slow, so that is left
+   to report_spurious() on the system work queue. */
 static void
 interrupt_handler (struct intr_frame *f) 
 {
@@ -517,11 +863,34 @@ interrupt_handler (struct intr_frame *f)
             sema_up (&c->completion_wait);      /* Wake up waiter. */
           }
         else
-          printf ("%s: unexpected interrupt\n", c->name);
+          {
+            c->spurious_cnt++;
+            workqueue_queue (system_wq, &c->spurious_work);
+          }
         return;
       }
 
   NOT_REACHED ();
 }
 
+/* Bottom half of interrupt_handler(): reports the unexpected
+   interrupts received on a channel since the last report. */
+static void
+report_spurious (struct work *w) 
+{
+  struct channel *c = work_entry (w, struct channel, spurious_work);
+  enum intr_level old_level;
+  unsigned cnt;
+
+  old_level = intr_disable ();
+  cnt = c->spurious_cnt;
+  c->spurious_cnt = 0;
+  intr_set_level (old_level);
+
+  if (cnt == 1)
+    printf ("%s: unexpected interrupt\n", c->name);
+  else if (cnt > 1)
+    printf ("%s: %u unexpected interrupts\n", c->name, cnt);
+}
+
 
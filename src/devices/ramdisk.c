@@ -0,0 +1,167 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* RAM disks.
+
+   A RAM disk is a block device whose sectors are kept in kernel
+   memory, so that requests complete without any device latency.
+   This makes it possible to measure the file system and virtual
+   memory code apart from the disk, and to run swap-heavy work
+   quickly.  Its contents are lost at power off.
+
+   RAM disks are created at startup as given by -ramdisk options,
+   each of which names a role, "swap" or "scratch", and a size in
+   kB.  They are registered ahead of the IDE disks, so they are
+   chosen for their role unless -swap or -scratch says otherwise. */
+
+/* Most RAM disks that may be configured. */
+#define RAMDISK_MAX 2
+
+/* Number of sectors in a page. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* A RAM disk. */
+struct ramdisk
+  {
+    enum block_type role;       /* BLOCK_SWAP or BLOCK_SCRATCH. */
+    block_sector_t size;        /* Size in sectors. */
+    uint8_t **pages;            /* Pages holding the sectors. */
+  };
+
+static struct ramdisk ramdisks[RAMDISK_MAX];
+static size_t ramdisk_cnt;
+
+static struct block_operations ramdisk_operations;
+
+/* Records SPEC, the value of a -ramdisk option, which has the
+   form ROLE,KB, so that ramdisk_init() will create a RAM disk of
+   KB kB for ROLE.  Panics if SPEC is malformed. */
+void
+ramdisk_configure (const char *spec) 
+{
+  struct ramdisk *rd;
+  const char *comma;
+  int kb;
+
+  if (ramdisk_cnt >= RAMDISK_MAX)
+    PANIC ("too many -ramdisk options");
+  rd = &ramdisks[ramdisk_cnt];
+
+  comma = spec != NULL ? strchr (spec, ',') : NULL;
+  if (comma == NULL)
+    PANIC ("-ramdisk requires ROLE,KB");
+  if (comma - spec == 4 && !memcmp (spec, "swap", 4))
+    rd->role = BLOCK_SWAP;
+  else if (comma - spec == 7 && !memcmp (spec, "scratch", 7))
+    rd->role = BLOCK_SCRATCH;
+  else
+    PANIC ("-ramdisk role must be \"swap\" or \"scratch\"");
+
+  kb = atoi (comma + 1);
+  if (kb <= 0)
+    PANIC ("-ramdisk size must be positive");
+  rd->size = kb * (1024 / BLOCK_SECTOR_SIZE);
+  ramdisk_cnt++;
+}
+
+/* Creates and registers the RAM disks given by -ramdisk options.
+   Their memory comes from the kernel pool, one page at a time,
+   so they need not be physically contiguous. */
+void
+ramdisk_init (void) 
+{
+  size_t i;
+
+  for (i = 0; i < ramdisk_cnt; i++)
+    {
+      struct ramdisk *rd = &ramdisks[i];
+      size_t page_cnt = DIV_ROUND_UP (rd->size, SECTORS_PER_PAGE);
+      char name[16];
+      size_t j;
+
+      rd->pages = malloc (page_cnt * sizeof *rd->pages);
+      if (rd->pages == NULL)
+        PANIC ("ram%zu: out of memory", i);
+      for (j = 0; j < page_cnt; j++)
+        {
+          rd->pages[j] = palloc_get_page (PAL_ZERO);
+          if (rd->pages[j] == NULL)
+            PANIC ("ram%zu: out of memory after %zu kB", i, j * PGSIZE / 1024);
+        }
+
+      snprintf (name, sizeof name, "ram%zu", i);
+      block_register (name, rd->role, "RAM disk", rd->size,
+                      &ramdisk_operations, rd);
+    }
+}
+
+/* Returns the address of sector SEC_NO of RAM disk RD. */
+static uint8_t *
+sector_addr (struct ramdisk *rd, block_sector_t sec_no) 
+{
+  ASSERT (sec_no < rd->size);
+  return (rd->pages[sec_no / SECTORS_PER_PAGE]
+          + sec_no % SECTORS_PER_PAGE * BLOCK_SECTOR_SIZE);
+}
+
+/* Reads sector SEC_NO from RAM disk RD into BUFFER, which must
+   have room for BLOCK_SECTOR_SIZE bytes.
+   The block layer's dispatch thread is the only caller, so no
+   locking is needed. */
+static void
+ramdisk_read (void *rd, block_sector_t sec_no, void *buffer)
+{
+  memcpy (buffer, sector_addr (rd, sec_no), BLOCK_SECTOR_SIZE);
+}
+
+/* Writes sector SEC_NO to RAM disk RD from BUFFER, which must
+   contain BLOCK_SECTOR_SIZE bytes. */
+static void
+ramdisk_write (void *rd, block_sector_t sec_no, const void *buffer)
+{
+  memcpy (sector_addr (rd, sec_no), buffer, BLOCK_SECTOR_SIZE);
+}
+
+/* Reads consecutive sectors of RAM disk RD, starting at SEC_NO,
+   into the IOV_CNT buffers in IOV. */
+static void
+ramdisk_readv (void *rd, block_sector_t sec_no,
+               const struct block_iovec *iov, size_t iov_cnt)
+{
+  size_t i, j;
+
+  for (i = 0; i < iov_cnt; i++)
+    for (j = 0; j < iov[i].sector_cnt; j++)
+      ramdisk_read (rd, sec_no++,
+                    (uint8_t *) iov[i].buffer + j * BLOCK_SECTOR_SIZE);
+}
+
+/* Writes consecutive sectors of RAM disk RD, starting at SEC_NO,
+   from the IOV_CNT buffers in IOV. */
+static void
+ramdisk_writev (void *rd, block_sector_t sec_no,
+                const struct block_iovec *iov, size_t iov_cnt)
+{
+  size_t i, j;
+
+  for (i = 0; i < iov_cnt; i++)
+    for (j = 0; j < iov[i].sector_cnt; j++)
+      ramdisk_write (rd, sec_no++,
+                     (uint8_t *) iov[i].buffer + j * BLOCK_SECTOR_SIZE);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    ramdisk_readv,
+    ramdisk_writev
+  };
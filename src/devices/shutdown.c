@@ -5,12 +5,17 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #endif
 
@@ -120,8 +125,16 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  palloc_print_stats ();
+  malloc_print_stats ();
+  slab_print_stats ();
+#ifdef LOCKSTAT
+  lock_print_stats ();
+#endif
 #ifdef FILESYS
   block_print_stats ();
+  cache_print_stats ();
+  dcache_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
@@ -0,0 +1,683 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <round.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "threads/workqueue.h"
+
+/* Buffer cache.
+
+   Keeps the most recently used sectors of the file system
+   device in memory, so that the inode, directory, and free map
+   code can read and write pieces of sectors without going to
+   the disk each time.
+
+   Writes only change the cached copy and mark it dirty.  Dirty
+   sectors are written back when their entry is reused for
+   another sector, when cache_flush() or cache_flush_runs() is
+   called, or by the "flusher" thread once they have been dirty
+   for cache_flush_age ticks, so that a burst of writes returns
+   quickly but does not stay only in memory for long.  All of
+   these but reuse write dirty sectors in order of sector number,
+   grouped into runs of adjacent sectors.
+
+   Entries are replaced with the clock algorithm: each entry has
+   an "accessed" bit that is set whenever it is used, and the
+   clock hand sweeps over the entries, clearing accessed bits,
+   until it finds an entry that has not been used since the last
+   sweep.
+
+   Locking is in two levels.  CACHE_LOCK protects the mapping
+   from sectors to entries, along with each entry's sector,
+   accessed bit and pin count.  Each entry also has a
+   readers-writer lock that protects its data, so that threads
+   working on different sectors do not wait for each other's
+   disk I/O, and threads reading the same sector share it.  A
+   thread "pins" an entry under CACHE_LOCK before taking its
+   lock, and an entry is reused only while it is unpinned, so
+   a pinned entry keeps its sector.
+
+   cache_readahead() queues a sector to be read in by a
+   background thread, so that a thread reading a file
+   sequentially finds the next sectors already in the cache
+   instead of waiting for the disk one sector at a time. */
+
+/* A cached sector. */
+struct cache_entry
+  {
+    struct hash_elem hash_elem; /* Element in cache_map. */
+    block_sector_t sector;      /* Sector held, if mapped. */
+    bool mapped;                /* In cache_map? */
+    bool accessed;              /* Used since the clock hand passed? */
+    unsigned pin_cnt;           /* Number of threads using the entry. */
+    bool readahead;             /* Read ahead and not used since? */
+
+    struct rwlock rwlock;       /* Protects the members below. */
+    bool valid;                 /* DATA holds SECTOR's contents? */
+    bool dirty;                 /* DATA newer than the disk? */
+    int64_t dirty_tick;         /* When DATA became dirty. */
+    uint8_t *data;              /* BLOCK_SECTOR_SIZE bytes. */
+  };
+
+size_t cache_sector_cnt = CACHE_DEFAULT_SECTORS;
+int64_t cache_flush_age = CACHE_DEFAULT_FLUSH_AGE;
+
+static struct cache_entry *entries; /* All the entries. */
+static struct hash cache_map;       /* Mapped entries, by sector. */
+static size_t clock_hand;           /* Next entry to consider for reuse. */
+static struct lock cache_lock;      /* Protects the above. */
+static struct condition unpinned;   /* Signaled when pin_cnt drops to 0. */
+
+/* Sectors waiting to be read ahead, in a circular queue also
+   protected by CACHE_LOCK.  Requests that find the queue full
+   are dropped. */
+#define READAHEAD_QUEUE_SIZE 64
+static block_sector_t ra_queue[READAHEAD_QUEUE_SIZE];
+static size_t ra_head;              /* Index of oldest request. */
+static size_t ra_cnt;               /* Number of requests queued. */
+static struct workqueue *readahead_wq;
+static struct work readahead_work;
+
+/* Periodic write-back.  FLUSH_LOCK serializes flush_dirty(),
+   which uses FLUSH_LIST to sort the entries it writes. */
+#define FLUSH_RUN_MAX 8             /* Most sectors in a run. */
+static struct workqueue *flusher_wq;
+static struct work flusher_work;
+static struct lock flush_lock;
+static struct cache_entry **flush_list;
+
+/* Statistics, protected by CACHE_LOCK. */
+static unsigned long long hit_cnt;        /* Sector found in cache. */
+static unsigned long long miss_cnt;       /* Sector not found. */
+static unsigned long long write_back_cnt; /* Dirty sectors written. */
+static unsigned long long readahead_cnt;  /* Sectors read ahead. */
+static unsigned long long ra_hit_cnt;     /* ...and later used. */
+static unsigned long long run_cnt;        /* Runs written by flushes. */
+
+static hash_hash_func entry_hash;
+static hash_less_func entry_less;
+static struct cache_entry *lookup (block_sector_t);
+static struct cache_entry *pin (block_sector_t, bool demand);
+static void unpin (struct cache_entry *);
+static void readahead_worker (struct work *);
+static void prefetch (block_sector_t);
+static void flusher (struct work *);
+static void flush_dirty (int64_t min_age);
+static void write_sorted (struct cache_entry **, size_t cnt,
+                          enum block_class);
+static void write_run (struct cache_entry **, size_t cnt, enum block_class);
+static int compare_runs (const void *, const void *);
+static struct cache_entry *choose_victim (void);
+static void write_back (struct cache_entry *);
+
+/* Initializes the buffer cache with cache_sector_cnt entries. */
+void
+cache_init (void)
+{
+  size_t page_cnt;
+  uint8_t *data;
+  size_t i;
+
+  if (cache_sector_cnt == 0)
+    PANIC ("buffer cache must have at least one sector");
+
+  page_cnt = DIV_ROUND_UP (cache_sector_cnt * BLOCK_SECTOR_SIZE, PGSIZE);
+  entries = calloc (cache_sector_cnt, sizeof *entries);
+  flush_list = calloc (cache_sector_cnt, sizeof *flush_list);
+  data = palloc_get_multiple (0, page_cnt);
+  if (entries == NULL || flush_list == NULL || data == NULL
+      || !hash_init (&cache_map, entry_hash, entry_less, NULL))
+    PANIC ("could not allocate %zu-sector buffer cache", cache_sector_cnt);
+
+  for (i = 0; i < cache_sector_cnt; i++)
+    {
+      struct cache_entry *e = &entries[i];
+      rwlock_init (&e->rwlock);
+      e->data = data + i * BLOCK_SECTOR_SIZE;
+    }
+  lock_init (&cache_lock);
+  lock_set_name (&cache_lock, "cache");
+  cond_init (&unpinned);
+
+  readahead_wq = workqueue_create ("readahead", PRI_DEFAULT, 1);
+  if (readahead_wq == NULL)
+    PANIC ("could not create read-ahead thread");
+  work_init (&readahead_work, readahead_worker);
+
+  lock_init (&flush_lock);
+  flusher_wq = workqueue_create ("flusher", PRI_DEFAULT, 1);
+  if (flusher_wq == NULL)
+    PANIC ("could not create flusher thread");
+  work_init (&flusher_work, flusher);
+  workqueue_queue (flusher_wq, &flusher_work);
+}
+
+/* Reads SIZE bytes from SECTOR into BUFFER, starting at byte
+   offset OFS within the sector. */
+void
+cache_read (block_sector_t sector, void *buffer, size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = pin (sector, true);
+  rwlock_acquire_read (&e->rwlock);
+  if (e->valid)
+    {
+      memcpy (buffer, e->data + ofs, size);
+      rwlock_release_read (&e->rwlock);
+    }
+  else
+    {
+      /* Someone has to read the sector in.  Check again once we
+         have the entry to ourselves, in case another thread
+         beat us to it. */
+      rwlock_release_read (&e->rwlock);
+      rwlock_acquire_write (&e->rwlock);
+      if (!e->valid)
+        {
+          block_read (fs_device, sector, e->data);
+          e->valid = true;
+        }
+      memcpy (buffer, e->data + ofs, size);
+      rwlock_release_write (&e->rwlock);
+    }
+  unpin (e);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR, starting at byte
+   offset OFS within the sector.  The data reaches the disk
+   later. */
+void
+cache_write (block_sector_t sector, const void *buffer, size_t ofs,
+             size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = pin (sector, true);
+  rwlock_acquire_write (&e->rwlock);
+  if (!e->valid)
+    {
+      /* Writing a whole sector does not need its old contents. */
+      if (size < BLOCK_SECTOR_SIZE)
+        block_read (fs_device, sector, e->data);
+      e->valid = true;
+    }
+  memcpy (e->data + ofs, buffer, size);
+  if (!e->dirty)
+    {
+      e->dirty = true;
+      e->dirty_tick = timer_ticks ();
+    }
+  rwlock_release_write (&e->rwlock);
+  unpin (e);
+}
+
+/* Starts reading SECTOR into the cache in the background, unless
+   it is already there.  Does not wait for the read. */
+void
+cache_readahead (block_sector_t sector)
+{
+  bool queued = false;
+
+  lock_acquire (&cache_lock);
+  if (lookup (sector) == NULL && ra_cnt < READAHEAD_QUEUE_SIZE)
+    {
+      ra_queue[(ra_head + ra_cnt++) % READAHEAD_QUEUE_SIZE] = sector;
+      queued = true;
+    }
+  lock_release (&cache_lock);
+
+  if (queued)
+    workqueue_queue (readahead_wq, &readahead_work);
+}
+
+/* Writes every dirty sector in the cache to disk. */
+void
+cache_flush (void)
+{
+  flush_dirty (0);
+}
+
+/* Writes every cached, dirty sector that lies in one of the
+   RUN_CNT runs in RUNS to disk, returning once they are there.
+   Sorts RUNS by starting sector. */
+void
+cache_flush_runs (struct sector_run *runs, size_t run_cnt)
+{
+  struct cache_entry **list;
+  size_t cnt = 0;
+  size_t i;
+
+  list = malloc (cache_sector_cnt * sizeof *list);
+  if (list == NULL)
+    {
+      flush_dirty (0);
+      return;
+    }
+
+  qsort (runs, run_cnt, sizeof *runs, compare_runs);
+
+  /* Pin the entries to write, in a single pass over the cache.
+     As in flush_dirty(), the dirty bit is only a hint here. */
+  lock_acquire (&cache_lock);
+  for (i = 0; i < cache_sector_cnt; i++)
+    {
+      struct cache_entry *e = &entries[i];
+      struct sector_run key;
+
+      key.start = e->sector;
+      key.cnt = 1;
+      if (e->mapped && e->dirty
+          && bsearch (&key, runs, run_cnt, sizeof *runs, compare_runs))
+        {
+          e->pin_cnt++;
+          list[cnt++] = e;
+        }
+    }
+  lock_release (&cache_lock);
+
+  write_sorted (list, cnt, BLOCK_FOREGROUND);
+  free (list);
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  lock_acquire (&cache_lock);
+  printf ("Buffer cache: %zu sectors, %llu hits, %llu misses, "
+          "%llu write-backs in %llu runs, %llu read ahead (%llu used)\n",
+          cache_sector_cnt, hit_cnt, miss_cnt, write_back_cnt, run_cnt,
+          readahead_cnt, ra_hit_cnt);
+  lock_release (&cache_lock);
+}
+
+/* Returns the entry mapped to SECTOR, or a null pointer if there
+   is none.  CACHE_LOCK must be held. */
+static struct cache_entry *
+lookup (block_sector_t sector)
+{
+  struct cache_entry key;
+  struct hash_elem *found;
+
+  key.sector = sector;
+  found = hash_find (&cache_map, &key.hash_elem);
+  return found != NULL ? hash_entry (found, struct cache_entry, hash_elem)
+                       : NULL;
+}
+
+/* Returns the entry for SECTOR, pinned, reusing another entry if
+   SECTOR is not cached.  The entry's data is not valid if it was
+   reused.  DEMAND is false for read-ahead, which is not counted
+   as a hit or a miss. */
+static struct cache_entry *
+pin (block_sector_t sector, bool demand)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      e = lookup (sector);
+      if (e != NULL)
+        {
+          if (demand)
+            {
+              hit_cnt++;
+              if (e->readahead)
+                {
+                  ra_hit_cnt++;
+                  e->readahead = false;
+                }
+            }
+          break;
+        }
+
+      e = choose_victim ();
+      if (e == NULL)
+        {
+          /* Every entry is in use.  Wait for one to be freed up. */
+          cond_wait (&unpinned, &cache_lock);
+          continue;
+        }
+      if (e->dirty)
+        {
+          /* Write the victim back before letting go of its old
+             sector, so that no one can read that sector from the
+             disk while its newest contents are only here.  Then
+             look again, because SECTOR may have been brought in
+             meanwhile. */
+          e->pin_cnt++;
+          lock_release (&cache_lock);
+          write_back (e);
+          unpin (e);
+          lock_acquire (&cache_lock);
+          continue;
+        }
+
+      /* Reuse E for SECTOR.  Being unpinned, no one holds its
+         lock. */
+      if (e->mapped)
+        hash_delete (&cache_map, &e->hash_elem);
+      e->sector = sector;
+      e->mapped = true;
+      e->valid = false;
+      e->readahead = false;
+      hash_insert (&cache_map, &e->hash_elem);
+      if (demand)
+        miss_cnt++;
+      break;
+    }
+  e->pin_cnt++;
+  e->accessed = true;
+  lock_release (&cache_lock);
+
+  return e;
+}
+
+/* Releases a pin on E. */
+static void
+unpin (struct cache_entry *e)
+{
+  lock_acquire (&cache_lock);
+  ASSERT (e->pin_cnt > 0);
+  if (--e->pin_cnt == 0)
+    cond_broadcast (&unpinned, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Reads in the sectors queued by cache_readahead(). */
+static void
+readahead_worker (struct work *w UNUSED)
+{
+  for (;;)
+    {
+      block_sector_t sector;
+
+      lock_acquire (&cache_lock);
+      if (ra_cnt == 0)
+        {
+          lock_release (&cache_lock);
+          break;
+        }
+      sector = ra_queue[ra_head];
+      ra_head = (ra_head + 1) % READAHEAD_QUEUE_SIZE;
+      ra_cnt--;
+      lock_release (&cache_lock);
+
+      prefetch (sector);
+    }
+}
+
+/* Reads SECTOR into the cache, unless it is already there or
+   someone else is using its entry. */
+static void
+prefetch (block_sector_t sector)
+{
+  struct cache_entry *e = pin (sector, false);
+  bool loaded = false;
+
+  if (rwlock_try_acquire_write (&e->rwlock))
+    {
+      if (!e->valid)
+        {
+          /* Let reads that someone is waiting for go first. */
+          struct block_iovec iov = {e->data, 1};
+          struct block_request r;
+
+          block_request_init (&r, false, sector, &iov, 1);
+          r.class = BLOCK_BACKGROUND;
+          block_submit (fs_device, &r);
+          block_wait (&r);
+          e->valid = true;
+          loaded = true;
+        }
+      rwlock_release_write (&e->rwlock);
+    }
+
+  if (loaded)
+    {
+      lock_acquire (&cache_lock);
+      e->readahead = true;
+      readahead_cnt++;
+      lock_release (&cache_lock);
+    }
+  unpin (e);
+}
+
+/* Writes back the sectors that have been dirty for at least
+   cache_flush_age ticks, then runs itself again after half that
+   time. */
+static void
+flusher (struct work *w)
+{
+  int64_t interval = cache_flush_age / 2;
+
+  flush_dirty (cache_flush_age);
+  workqueue_queue_delayed (flusher_wq, w, interval > 0 ? interval : 1);
+}
+
+/* Writes to disk every sector that has been dirty for at least
+   MIN_AGE ticks, in ascending order of sector number, in runs of
+   adjacent sectors.  Periodic flushes, with a nonzero MIN_AGE,
+   give way to other disk requests; flushes of everything are
+   waited for by someone, so they do not. */
+static void
+flush_dirty (int64_t min_age)
+{
+  enum block_class class = min_age > 0 ? BLOCK_BACKGROUND : BLOCK_FOREGROUND;
+  int64_t now = timer_ticks ();
+  size_t cnt = 0;
+  size_t i;
+
+  lock_acquire (&flush_lock);
+
+  /* Pin the entries to write.  The dirty bit and tick are only
+     a hint here, since they are protected by each entry's own
+     lock; write_run() checks again. */
+  lock_acquire (&cache_lock);
+  for (i = 0; i < cache_sector_cnt; i++)
+    {
+      struct cache_entry *e = &entries[i];
+      if (e->mapped && e->dirty && now - e->dirty_tick >= min_age)
+        {
+          e->pin_cnt++;
+          flush_list[cnt++] = e;
+        }
+    }
+  lock_release (&cache_lock);
+
+  write_sorted (flush_list, cnt, class);
+  lock_release (&flush_lock);
+}
+
+/* Sorts the CNT pinned entries in LIST by sector, writes them in
+   runs of adjacent sectors with requests in queue class CLASS,
+   and unpins them. */
+static void
+write_sorted (struct cache_entry **list, size_t cnt, enum block_class class)
+{
+  size_t i, j;
+
+  /* Insertion sort by sector.  The list is usually short. */
+  for (i = 1; i < cnt; i++)
+    {
+      struct cache_entry *e = list[i];
+      for (j = i; j > 0 && list[j - 1]->sector > e->sector; j--)
+        list[j] = list[j - 1];
+      list[j] = e;
+    }
+
+  /* Write runs of adjacent sectors. */
+  for (i = 0; i < cnt; i = j)
+    {
+      for (j = i + 1; j < cnt && j - i < FLUSH_RUN_MAX; j++)
+        if (list[j]->sector != list[j - 1]->sector + 1)
+          break;
+      write_run (list + i, j - i, class);
+    }
+
+  for (i = 0; i < cnt; i++)
+    unpin (list[i]);
+}
+
+/* Writes the CNT pinned entries in RUN, which hold adjacent
+   sectors in ascending order, back to back, with one request in
+   queue class CLASS for each stretch of dirty entries.  The
+   whole run is locked exclusively, in ascending order, until it
+   has been written, so that it reaches the disk as one
+   consistent unit and no write can slip in between writing an
+   entry and clearing its dirty bit. */
+static void
+write_run (struct cache_entry **run, size_t cnt, enum block_class class)
+{
+  struct block_request requests[FLUSH_RUN_MAX];
+  struct block_iovec iov[FLUSH_RUN_MAX];
+  block_sector_t start = 0;
+  size_t request_cnt = 0;
+  size_t iov_cnt = 0, first = 0;
+  size_t i;
+
+  ASSERT (cnt <= FLUSH_RUN_MAX);
+
+  for (i = 0; i < cnt; i++)
+    rwlock_acquire_write (&run[i]->rwlock);
+  for (i = 0; i <= cnt; i++)
+    {
+      struct cache_entry *e = i < cnt ? run[i] : NULL;
+      if (e != NULL && e->valid && e->dirty)
+        {
+          if (iov_cnt == first)
+            start = e->sector;
+          iov[iov_cnt].buffer = e->data;
+          iov[iov_cnt].sector_cnt = 1;
+          iov_cnt++;
+          e->dirty = false;
+        }
+      else if (iov_cnt > first)
+        {
+          struct block_request *r = &requests[request_cnt++];
+          block_request_init (r, true, start, iov + first, iov_cnt - first);
+          r->class = class;
+          block_submit (fs_device, r);
+          first = iov_cnt;
+        }
+    }
+  for (i = 0; i < request_cnt; i++)
+    block_wait (&requests[i]);
+  for (i = 0; i < cnt; i++)
+    rwlock_release_write (&run[i]->rwlock);
+
+  if (request_cnt > 0)
+    {
+      lock_acquire (&cache_lock);
+      write_back_cnt += iov_cnt;
+      run_cnt++;
+      lock_release (&cache_lock);
+    }
+}
+
+/* Runs the clock hand until it finds an unpinned entry that has
+   not been accessed since the hand last passed it, and returns
+   that entry, or returns a null pointer if every entry is
+   pinned.  CACHE_LOCK must be held. */
+static struct cache_entry *
+choose_victim (void)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  /* Two sweeps suffice: the first clears all the accessed
+     bits. */
+  for (i = 0; i < 2 * cache_sector_cnt; i++)
+    {
+      struct cache_entry *e = &entries[clock_hand];
+      if (++clock_hand >= cache_sector_cnt)
+        clock_hand = 0;
+
+      if (e->pin_cnt > 0)
+        continue;
+      if (e->accessed)
+        e->accessed = false;
+      else
+        return e;
+    }
+  return NULL;
+}
+
+/* Writes E's data to disk if it is dirty.  E must be pinned.
+   Holds E's lock exclusively, so that the dirty bit cannot be
+   set again between the write and clearing it. */
+static void
+write_back (struct cache_entry *e)
+{
+  bool written = false;
+
+  rwlock_acquire_write (&e->rwlock);
+  if (e->valid && e->dirty)
+    {
+      block_write (fs_device, e->sector, e->data);
+      e->dirty = false;
+      written = true;
+    }
+  rwlock_release_write (&e->rwlock);
+
+  if (written)
+    {
+      lock_acquire (&cache_lock);
+      write_back_cnt++;
+      lock_release (&cache_lock);
+    }
+}
+
+/* Returns a hash of entry E_'s sector. */
+static unsigned
+entry_hash (const struct hash_elem *e_, void *aux UNUSED)
+{
+  const struct cache_entry *e = hash_entry (e_, struct cache_entry,
+                                            hash_elem);
+  return hash_int (e->sector);
+}
+
+/* Orders entries by sector. */
+static bool
+entry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct cache_entry *a = hash_entry (a_, struct cache_entry,
+                                            hash_elem);
+  const struct cache_entry *b = hash_entry (b_, struct cache_entry,
+                                            hash_elem);
+  return a->sector < b->sector;
+}
+
+/* Orders sector runs A_ and B_ by starting sector, treating runs
+   that overlap as equal, so that bsearch() can find the run that
+   holds a given sector. */
+static int
+compare_runs (const void *a_, const void *b_)
+{
+  const struct sector_run *a = a_;
+  const struct sector_run *b = b_;
+
+  if (a->start + a->cnt <= b->start)
+    return -1;
+  else if (b->start + b->cnt <= a->start)
+    return 1;
+  else
+    return 0;
+}
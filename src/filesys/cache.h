@@ -0,0 +1,41 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+
+/* Default number of sectors in the buffer cache. */
+#define CACHE_DEFAULT_SECTORS 64
+
+/* Number of sectors in the buffer cache.  May be changed with
+   the -cache kernel option before cache_init() is called. */
+extern size_t cache_sector_cnt;
+
+/* Default age, in timer ticks, at which dirty sectors are
+   written back. */
+#define CACHE_DEFAULT_FLUSH_AGE (5 * TIMER_FREQ)
+
+/* Dirty sectors are written back by a background thread once
+   they have been dirty for this many timer ticks.  May be
+   changed with the -flush kernel option. */
+extern int64_t cache_flush_age;
+
+/* A run of CNT sectors starting at START. */
+struct sector_run
+  {
+    block_sector_t start;
+    size_t cnt;
+  };
+
+void cache_init (void);
+void cache_read (block_sector_t, void *buffer, size_t ofs, size_t size);
+void cache_write (block_sector_t, const void *buffer, size_t ofs,
+                  size_t size);
+void cache_readahead (block_sector_t);
+void cache_flush (void);
+void cache_flush_runs (struct sector_run *, size_t run_cnt);
+void cache_print_stats (void);
+
+#endif /* filesys/cache.h */
@@ -0,0 +1,259 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Directory entry cache.
+
+   Maps a (directory, name) pair, where the directory is given by
+   its inode's sector, to the sector of the named file's inode,
+   so that resolving a path whose components were resolved
+   recently does not need to search each directory along it.
+
+   A "negative" entry, whose sector is DCACHE_NEGATIVE, records
+   that the directory has no file by that name, which saves a
+   search of the whole bucket chain for names that are looked up
+   repeatedly but do not exist.
+
+   The cache is only a hint as to what the directories contain,
+   so the directory code must keep it in step: dir_add() and
+   dir_remove() update the entry for the name they change while
+   holding the directory's lock, and dir_create() purges the
+   entries of a directory whose sector is being reused.
+
+   Every path lookup goes through the cache, so lookups take no
+   lock.  Instead, they run inside DCACHE_EPOCH, and updates,
+   which are serialized by DCACHE_LOCK, follow two rules.  An
+   entry is filled in completely before it is linked into its
+   hash chain.  An entry that has been unlinked is not reused for
+   another name until epoch_synchronize() has waited out every
+   lookup that might still be looking at it.  The hash table has
+   a fixed number of chains, so it never moves entries around
+   under a lookup.
+
+   When the cache is full, an entry is replaced with the clock
+   algorithm: lookups set an entry's "referenced" bit, and the
+   clock hand passes over referenced entries, clearing the bit,
+   until it finds one that has not been used since the last
+   sweep. */
+
+/* Number of entries in the cache. */
+#define DCACHE_SIZE 256
+
+/* Number of hash chains. */
+#define DCACHE_BUCKETS 64
+
+/* A cached name. */
+struct dentry
+  {
+    struct dentry *next;                /* Next entry in hash chain. */
+    bool in_map;                        /* In a hash chain? */
+    bool referenced;                    /* Used since the clock passed? */
+    block_sector_t dir;                 /* Directory's inode sector. */
+    char name[NAME_MAX + 1];            /* Name within DIR. */
+    block_sector_t sector;              /* Inode sector or DCACHE_NEGATIVE. */
+  };
+
+static struct dentry *dentries;     /* All the entries. */
+static struct dentry *buckets[DCACHE_BUCKETS]; /* Hash chains. */
+static size_t clock_hand;           /* Next entry to consider for reuse. */
+static struct lock dcache_lock;     /* Serializes updates. */
+static struct epoch dcache_epoch;   /* Protects lookups. */
+
+/* Statistics.  Updated with interrupts off, because lookups
+   take no lock. */
+static unsigned long long hit_cnt;      /* Positive entry found. */
+static unsigned long long neg_hit_cnt;  /* Negative entry found. */
+static unsigned long long miss_cnt;     /* Nothing found. */
+
+static struct dentry **bucket (block_sector_t dir, const char *name);
+static struct dentry *find (block_sector_t dir, const char *name);
+static void unlink (struct dentry *);
+static struct dentry *choose_victim (void);
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void)
+{
+  dentries = calloc (DCACHE_SIZE, sizeof *dentries);
+  if (dentries == NULL)
+    PANIC ("could not allocate directory entry cache");
+  lock_init (&dcache_lock);
+  lock_set_name (&dcache_lock, "dcache");
+  epoch_init (&dcache_epoch);
+}
+
+/* Looks up NAME in the directory whose inode is in sector DIR.
+   If the cache has an entry for it, stores the sector of NAME's
+   inode, or DCACHE_NEGATIVE if DIR has no file named NAME, into
+   *SECTORP and returns true.  Otherwise returns false. */
+bool
+dcache_lookup (block_sector_t dir, const char *name, block_sector_t *sectorp)
+{
+  enum intr_level old_level;
+  struct dentry *d;
+  block_sector_t sector = 0;
+  unsigned idx;
+
+  idx = epoch_enter (&dcache_epoch);
+  d = find (dir, name);
+  if (d != NULL)
+    {
+      d->referenced = true;
+      sector = d->sector;
+    }
+  epoch_exit (&dcache_epoch, idx);
+
+  old_level = intr_disable ();
+  if (d == NULL)
+    miss_cnt++;
+  else if (sector != DCACHE_NEGATIVE)
+    hit_cnt++;
+  else
+    neg_hit_cnt++;
+  intr_set_level (old_level);
+
+  if (d != NULL)
+    *sectorp = sector;
+  return d != NULL;
+}
+
+/* Records that NAME in the directory whose inode is in sector
+   DIR refers to the inode in SECTOR, or that there is no such
+   file if SECTOR is DCACHE_NEGATIVE.  Replaces any previous
+   entry for NAME in DIR.  Names too long to be in a directory
+   are not cached. */
+void
+dcache_insert (block_sector_t dir, const char *name, block_sector_t sector)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d == NULL)
+    {
+      struct dentry **b = bucket (dir, name);
+
+      /* Take over another entry, once no lookup can still be
+         comparing its old name.  Lookups never wait for
+         DCACHE_LOCK, so waiting for them while holding it is
+         safe. */
+      d = choose_victim ();
+      if (d->in_map)
+        unlink (d);
+      epoch_synchronize (&dcache_epoch);
+
+      d->dir = dir;
+      strlcpy (d->name, name, sizeof d->name);
+      d->sector = sector;
+      d->next = *b;
+      barrier ();
+      *b = d;
+      d->in_map = true;
+    }
+  else
+    d->sector = sector;
+  d->referenced = true;
+  lock_release (&dcache_lock);
+}
+
+/* Drops all the entries for names in the directory whose inode
+   is in sector DIR. */
+void
+dcache_purge (block_sector_t dir)
+{
+  size_t i;
+
+  lock_acquire (&dcache_lock);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    {
+      struct dentry *d = &dentries[i];
+      if (d->in_map && d->dir == dir)
+        {
+          unlink (d);
+          d->referenced = false;
+        }
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Prints directory entry cache statistics. */
+void
+dcache_print_stats (void)
+{
+  printf ("Dentry cache: %d entries, %llu hits, %llu negative hits, "
+          "%llu misses\n",
+          DCACHE_SIZE, hit_cnt, neg_hit_cnt, miss_cnt);
+}
+
+/* Returns the hash chain for NAME in DIR. */
+static struct dentry **
+bucket (block_sector_t dir, const char *name)
+{
+  return &buckets[(hash_int (dir) ^ hash_string (name)) % DCACHE_BUCKETS];
+}
+
+/* Returns the entry for NAME in DIR, or a null pointer if there
+   is none.  The caller must hold DCACHE_LOCK or be inside
+   DCACHE_EPOCH. */
+static struct dentry *
+find (block_sector_t dir, const char *name)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  for (d = *bucket (dir, name); d != NULL; d = d->next)
+    if (d->dir == dir && !strcmp (d->name, name))
+      return d;
+  return NULL;
+}
+
+/* Removes D from its hash chain.  D's own link is left alone, so
+   that a lookup that is looking at D still reaches the rest of
+   the chain.  DCACHE_LOCK must be held. */
+static void
+unlink (struct dentry *d)
+{
+  struct dentry **p;
+
+  ASSERT (lock_held_by_current_thread (&dcache_lock));
+  ASSERT (d->in_map);
+
+  for (p = bucket (d->dir, d->name); *p != d; p = &(*p)->next)
+    ASSERT (*p != NULL);
+  *p = d->next;
+  d->in_map = false;
+}
+
+/* Returns an entry to reuse: an unused one if there is one
+   under the clock hand, otherwise the first one that has not
+   been referenced since the hand last passed it.  DCACHE_LOCK
+   must be held. */
+static struct dentry *
+choose_victim (void)
+{
+  ASSERT (lock_held_by_current_thread (&dcache_lock));
+
+  for (;;)
+    {
+      struct dentry *d = &dentries[clock_hand];
+      if (++clock_hand >= DCACHE_SIZE)
+        clock_hand = 0;
+
+      if (!d->in_map)
+        return d;
+      if (d->referenced)
+        d->referenced = false;
+      else
+        return d;
+    }
+}
@@ -1,10 +1,16 @@
 #include "filesys/directory.h"
+#include <hash.h>
+#include <round.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* A directory. */
 struct dir 
@@ -13,6 +19,11 @@ struct dir
     off_t pos;                          /* Current position. */
   };
 
+/* Open directories. */
+static struct slab_cache dir_cache;
+
+static bool read_next (struct dir *, char name[NAME_MAX + 1]);
+
 /* A single directory entry. */
 struct dir_entry 
   {
@@ -21,21 +32,132 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* A directory's entries are kept in a hash table, so that
+   finding a name costs the same however many entries there are.
+
+   The directory's first sector is a header and each later sector
+   ("block") is a bucket of entries.  The buckets are indexed by
+   extendible hashing: the low DEPTH bits of hash_string() of a
+   name select an element of the header's TABLE, which gives the
+   block of the name's bucket.  Each bucket has its own depth,
+   which is at most DEPTH; a bucket of depth D is shared by all
+   the table elements that agree in their low D bits.  A full
+   bucket is split in two, by one more bit of the hash, doubling
+   the table first if its depth is already DEPTH.  Once the table
+   has MAX_DEPTH bits, full buckets are instead chained to
+   overflow buckets.
+
+   So a lookup reads the header and usually a single bucket,
+   both of which tend to stay in the buffer cache. */
+#define MAX_DEPTH 7
+#define BUCKET_ENTRY_CNT 25
+
+/* Directory header, in a directory's first sector. */
+struct dir_header 
+  {
+    uint32_t depth;                     /* Hash bits used to index TABLE. */
+    uint32_t block_cnt;                 /* Sectors in the directory. */
+    uint32_t parent;                    /* Parent directory's sector. */
+    uint16_t table[1 << MAX_DEPTH];     /* Block of each hash's bucket. */
+    uint8_t unused[244];                /* Not used. */
+  };
+
+/* Bucket of directory entries, one per sector. */
+struct dir_bucket 
+  {
+    struct dir_entry entries[BUCKET_ENTRY_CNT];
+    uint32_t depth;                     /* Hash bits shared by entries. */
+    uint32_t next;                      /* Overflow bucket, or 0. */
+    uint32_t unused;                    /* Not used. */
+  };
+
+/* Returns the byte offset of entry IDX of BLOCK. */
+static inline off_t
+entry_ofs (uint32_t block, size_t idx) 
+{
+  return block * BLOCK_SECTOR_SIZE + idx * sizeof (struct dir_entry);
+}
+
+/* Returns true if NAME is "." or "..", which every directory
+   implicitly contains. */
+static inline bool
+is_dot (const char *name) 
+{
+  return !strcmp (name, ".") || !strcmp (name, "..");
+}
+
+/* Returns the mask for the low DEPTH bits of a hash. */
+static inline unsigned
+depth_mask (uint32_t depth) 
+{
+  return (1u << depth) - 1;
+}
+
+/* Initializes the directory module. */
+void
+dir_init (void) 
+{
+  slab_cache_init (&dir_cache, "dir", sizeof (struct dir), NULL);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+   given SECTOR, whose ".." is the directory in sector PARENT.
+   The directory grows as needed past ENTRY_CNT entries.
+   Returns true if successful, false on failure. */
 bool
-dir_create (block_sector_t sector, size_t entry_cnt)
+dir_create (block_sector_t sector, size_t entry_cnt, block_sector_t parent)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir_header *h;
+  struct inode *inode;
+  uint32_t depth, i;
+  bool success = false;
+
+  /* Start with enough buckets for ENTRY_CNT entries. */
+  for (depth = 0; depth < MAX_DEPTH; depth++)
+    if ((1u << depth) * BUCKET_ENTRY_CNT >= entry_cnt)
+      break;
+
+  h = calloc (1, sizeof *h);
+  if (h == NULL)
+    return false;
+  h->depth = depth;
+  h->block_cnt = 1 + (1u << depth);
+  h->parent = parent;
+  for (i = 0; i < (1u << depth); i++)
+    h->table[i] = 1 + i;
+
+  /* Forget what the dentry cache knows about any directory that
+     used SECTOR before. */
+  dcache_purge (sector);
+
+  /* New inodes are zeroed, so each bucket starts out empty, with
+     depth 0 and no overflow bucket. */
+  if (inode_create (sector, h->block_cnt * BLOCK_SECTOR_SIZE, true))
+    {
+      inode = inode_open (sector);
+      if (inode != NULL)
+        {
+          success = inode_write_at (inode, h, sizeof *h, 0) == sizeof *h;
+          for (i = 0; success && depth > 0 && i < (1u << depth); i++)
+            success = (inode_write_at (inode, &depth, sizeof depth,
+                                       entry_ofs (h->table[i], 0)
+                                       + offsetof (struct dir_bucket, depth))
+                       == sizeof depth);
+          inode_close (inode);
+        }
+    }
+  free (h);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
-   it takes ownership.  Returns a null pointer on failure. */
+   it takes ownership.  Returns a null pointer on failure,
+   including if INODE is not a directory. */
 struct dir *
 dir_open (struct inode *inode) 
 {
-  struct dir *dir = calloc (1, sizeof *dir);
-  if (inode != NULL && dir != NULL)
+  struct dir *dir = slab_alloc (&dir_cache);
+  if (inode != NULL && inode_is_dir (inode) && dir != NULL)
     {
       dir->inode = inode;
       dir->pos = 0;
@@ -44,7 +166,7 @@ dir_open (struct inode *inode)
   else
     {
       inode_close (inode);
-      free (dir);
+      slab_free (&dir_cache, dir);
       return NULL; 
     }
 }
@@ -72,7 +194,7 @@ dir_close (struct dir *dir)
   if (dir != NULL)
     {
       inode_close (dir->inode);
-      free (dir);
+      slab_free (&dir_cache, dir);
     }
 }
 
@@ -83,51 +205,218 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
-/* Searches DIR for a file with the given NAME.
+/* Reads bucket BLOCK of DIR into B.
+   Returns true if successful, false on failure. */
+static bool
+read_bucket (const struct dir *dir, uint32_t block, struct dir_bucket *b) 
+{
+  return (inode_read_at (dir->inode, b, sizeof *b, entry_ofs (block, 0))
+          == sizeof *b);
+}
+
+/* Returns the block of the first bucket for names with the
+   given HASH in DIR, or 0 if it cannot be read. */
+static uint32_t
+find_bucket (const struct dir *dir, unsigned hash) 
+{
+  uint32_t depth = 0;
+  uint16_t block = 0;
+
+  inode_read_at (dir->inode, &depth, sizeof depth,
+                 offsetof (struct dir_header, depth));
+  if (depth <= MAX_DEPTH)
+    inode_read_at (dir->inode, &block, sizeof block,
+                   offsetof (struct dir_header, table)
+                   + (hash & depth_mask (depth)) * sizeof block);
+  return block;
+}
+
+/* Searches DIR for a file with the given NAME, using B as
+   scratch space for its buckets.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+   Either way, if FREEP is non-null, sets *FREEP to the offset of
+   a free slot in NAME's buckets, or to 0 if they are full, so
+   that dir_add() does not need to search for one. */
 static bool
-lookup (const struct dir *dir, const char *name,
-        struct dir_entry *ep, off_t *ofsp) 
+lookup (const struct dir *dir, const char *name, struct dir_bucket *b,
+        struct dir_entry *ep, off_t *ofsp, off_t *freep) 
 {
-  struct dir_entry e;
-  size_t ofs;
+  uint32_t block;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
-      }
+  if (freep != NULL)
+    *freep = 0;
+  for (block = find_bucket (dir, hash_string (name));
+       block != 0 && read_bucket (dir, block, b); block = b->next)
+    {
+      size_t i;
+
+      for (i = 0; i < BUCKET_ENTRY_CNT; i++) 
+        {
+          struct dir_entry *e = &b->entries[i];
+          if (e->in_use && !strcmp (name, e->name)) 
+            {
+              if (ep != NULL)
+                *ep = *e;
+              if (ofsp != NULL)
+                *ofsp = entry_ofs (block, i);
+              return true;
+            }
+          else if (!e->in_use && freep != NULL && *freep == 0)
+            *freep = entry_ofs (block, i);
+        }
+    }
   return false;
 }
 
+/* Makes room in DIR for a name with the given HASH, whose
+   buckets are all full, by splitting its bucket or, if the
+   bucket cannot be split, chaining an overflow bucket to it.
+   Returns the offset of a free slot, or 0 if the directory
+   cannot grow.  B and NB are scratch space for buckets. */
+static off_t
+make_room (struct dir *dir, unsigned hash, struct dir_bucket *b,
+           struct dir_bucket *nb) 
+{
+  struct dir_header *h;
+  off_t free_ofs = 0;
+
+  h = malloc (sizeof *h);
+  if (h == NULL
+      || inode_read_at (dir->inode, h, sizeof *h, 0) != sizeof *h)
+    goto done;
+
+  for (;;)
+    {
+      uint32_t block = h->table[hash & depth_mask (h->depth)];
+      uint32_t new_block = h->block_cnt;
+      struct dir_bucket *half;
+      unsigned bit;
+      size_t i;
+
+      if (!read_bucket (dir, block, b))
+        goto done;
+
+      if (b->depth >= MAX_DEPTH)
+        {
+          /* Chain a new bucket to the end of BLOCK's chain. */
+          while (b->next != 0)
+            {
+              block = b->next;
+              if (!read_bucket (dir, block, b))
+                goto done;
+            }
+          memset (nb, 0, sizeof *nb);
+          nb->depth = b->depth;
+          if (inode_write_at (dir->inode, nb, sizeof *nb,
+                              entry_ofs (new_block, 0)) != sizeof *nb)
+            goto done;
+          b->next = new_block;
+          inode_write_at (dir->inode, b, sizeof *b, entry_ofs (block, 0));
+          h->block_cnt++;
+          inode_write_at (dir->inode, h, sizeof *h, 0);
+          free_ofs = entry_ofs (new_block, 0);
+          goto done;
+        }
+
+      /* Split BLOCK by one more bit of hash, doubling the table
+         first if no bits are left. */
+      if (b->depth == h->depth)
+        {
+          for (i = 0; i < (1u << h->depth); i++)
+            h->table[i + (1u << h->depth)] = h->table[i];
+          h->depth++;
+        }
+      bit = 1u << b->depth;
+      b->depth++;
+      memset (nb, 0, sizeof *nb);
+      nb->depth = b->depth;
+      for (i = 0; i < BUCKET_ENTRY_CNT; i++)
+        if (b->entries[i].in_use && (hash_string (b->entries[i].name) & bit))
+          {
+            nb->entries[i] = b->entries[i];
+            b->entries[i].in_use = false;
+          }
+
+      /* Write the new bucket first, so that a full disk leaves
+         the directory as it was. */
+      if (inode_write_at (dir->inode, nb, sizeof *nb,
+                          entry_ofs (new_block, 0)) != sizeof *nb)
+        goto done;
+      inode_write_at (dir->inode, b, sizeof *b, entry_ofs (block, 0));
+      for (i = 0; i < (1u << h->depth); i++)
+        if (h->table[i] == block && (i & bit))
+          h->table[i] = new_block;
+      h->block_cnt++;
+      inode_write_at (dir->inode, h, sizeof *h, 0);
+
+      /* Use a free slot in HASH's half, if it has one. */
+      half = hash & bit ? nb : b;
+      block = hash & bit ? new_block : block;
+      for (i = 0; i < BUCKET_ENTRY_CNT; i++)
+        if (!half->entries[i].in_use)
+          {
+            free_ofs = entry_ofs (block, i);
+            goto done;
+          }
+    }
+
+ done:
+  free (h);
+  return free_ofs;
+}
+
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
+   "." names DIR itself and ".." its parent.  A directory that
+   has been removed contains nothing, not even those.
    On success, sets *INODE to an inode for the file, otherwise to
    a null pointer.  The caller must close *INODE. */
 bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
+  block_sector_t sector = DCACHE_NEGATIVE;
+  struct dir_bucket *b;
   struct dir_entry e;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
-  else
-    *inode = NULL;
+  *inode = NULL;
+  inode_lock_shared (dir->inode);
+  if (inode_is_removed (dir->inode))
+    ;
+  else if (!strcmp (name, "."))
+    *inode = inode_reopen (dir->inode);
+  else if (!strcmp (name, ".."))
+    {
+      uint32_t parent;
+      if (inode_read_at (dir->inode, &parent, sizeof parent,
+                         offsetof (struct dir_header, parent))
+          == sizeof parent)
+        *inode = inode_open (parent);
+    }
+  else if (!dcache_lookup (inode_get_inumber (dir->inode), name, &sector))
+    {
+      /* Not cached: search DIR, and remember what we found. */
+      b = malloc (sizeof *b);
+      if (b != NULL)
+        {
+          if (lookup (dir, name, b, &e, NULL, NULL))
+            sector = e.inode_sector;
+          dcache_insert (inode_get_inumber (dir->inode), name, sector);
+          free (b);
+        }
+    }
+  if (sector != DCACHE_NEGATIVE)
+    *inode = inode_open (sector);
+  inode_unlock_shared (dir->inode);
 
   return *inode != NULL;
 }
@@ -141,6 +430,7 @@ dir_lookup (const struct dir *dir, const char *name,
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
+  struct dir_bucket *b;
   struct dir_entry e;
   off_t ofs;
   bool success = false;
@@ -149,51 +439,67 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   ASSERT (name != NULL);
 
   /* Check NAME for validity. */
-  if (*name == '\0' || strlen (name) > NAME_MAX)
+  if (*name == '\0' || strlen (name) > NAME_MAX || is_dot (name))
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
-    goto done;
+  /* Two buckets of scratch space: one for lookup(), and both for
+     make_room(). */
+  b = malloc (2 * sizeof *b);
+  if (b == NULL)
+    return false;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+  /* Check that DIR still exists and NAME is not in use, and
+     find a free slot for NAME along the way, making one if there
+     is none. */
+  inode_lock (dir->inode);
+  if (inode_is_removed (dir->inode)
+      || lookup (dir, name, b, NULL, NULL, &ofs))
+    goto done;
+  if (ofs == 0)
+    ofs = make_room (dir, hash_string (name), b, b + 1);
+  if (ofs == 0)
+    goto done;
 
   /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  if (success)
+    dcache_insert (inode_get_inumber (dir->inode), name, inode_sector);
 
  done:
+  inode_unlock (dir->inode);
+  free (b);
   return success;
 }
 
 /* Removes any entry for NAME in DIR.
-   Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   Returns true if successful, false on failure, which occurs
+   if there is no file with the given NAME or if it is a
+   directory that is not empty. */
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
+  struct dir_bucket *b;
   struct dir_entry e;
   struct inode *inode = NULL;
+  bool is_dir = false;
   bool success = false;
   off_t ofs;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (is_dot (name))
+    return false;
+  b = malloc (sizeof *b);
+  if (b == NULL)
+    return false;
+
   /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  inode_lock (dir->inode);
+  if (!lookup (dir, name, b, &e, &ofs, NULL))
     goto done;
 
   /* Open inode. */
@@ -201,30 +507,60 @@ dir_remove (struct dir *dir, const char *name)
   if (inode == NULL)
     goto done;
 
+  /* A directory must be empty to be removed.  Holding its lock
+     until it is marked removed keeps dir_add() from adding to it
+     in the meantime. */
+  is_dir = inode_is_dir (inode);
+  if (is_dir)
+    {
+      struct dir child;
+      char child_name[NAME_MAX + 1];
+
+      inode_lock (inode);
+      child.inode = inode;
+      child.pos = 0;
+      if (read_next (&child, child_name))
+        goto done;
+    }
+
   /* Erase directory entry. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  dcache_insert (inode_get_inumber (dir->inode), name, DCACHE_NEGATIVE);
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  if (is_dir)
+    inode_unlock (inode);
+  inode_unlock (dir->inode);
   inode_close (inode);
+  free (b);
   return success;
 }
 
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
-bool
-dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
+   contains no more entries.  DIR's inode must be locked. */
+static bool
+read_next (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  for (;;)
     {
+      /* Skip the header and the end of each bucket. */
+      if (dir->pos < BLOCK_SECTOR_SIZE)
+        dir->pos = BLOCK_SECTOR_SIZE;
+      else if (dir->pos % BLOCK_SECTOR_SIZE
+               >= (off_t) offsetof (struct dir_bucket, depth))
+        dir->pos = ROUND_UP (dir->pos, BLOCK_SECTOR_SIZE);
+
+      if (inode_read_at (dir->inode, &e, sizeof e, dir->pos) != sizeof e)
+        return false;
       dir->pos += sizeof e;
       if (e.in_use)
         {
@@ -232,5 +568,33 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
           return true;
         } 
     }
-  return false;
+}
+
+/* Reads the next directory entry in DIR and stores the name in
+   NAME.  Returns true if successful, false if the directory
+   contains no more entries.  "." and ".." are not returned. */
+bool
+dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
+{
+  bool found;
+
+  inode_lock_shared (dir->inode);
+  found = read_next (dir, name);
+  inode_unlock_shared (dir->inode);
+  return found;
+}
+
+/* Sets DIR's position, as returned by dir_tell(), which is
+   where the next dir_readdir() will start. */
+void
+dir_seek (struct dir *dir, off_t pos) 
+{
+  dir->pos = pos;
+}
+
+/* Returns DIR's position. */
+off_t
+dir_tell (const struct dir *dir) 
+{
+  return dir->pos;
 }
@@ -1,7 +1,9 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include "filesys/cache.h"
+#include "filesys/directory.h"
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* An open file. */
 struct file 
@@ -9,26 +11,50 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+
+    /* Read-ahead state, see readahead(). */
+    off_t ra_next;              /* Position of next sequential read. */
+    off_t ra_end;               /* End of data already read ahead. */
+    size_t ra_window;           /* Sectors to read ahead, 0 if none. */
   };
 
+/* Smallest and largest read-ahead windows, in sectors. */
+#define READAHEAD_MIN 2
+#define READAHEAD_MAX 16
+
+/* Open files. */
+static struct slab_cache file_cache;
+
+static void readahead (struct file *, off_t size);
+
+/* Initializes the file module. */
+void
+file_init (void) 
+{
+  slab_cache_init (&file_cache, "file", sizeof (struct file), NULL);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = slab_alloc (&file_cache);
   if (inode != NULL && file != NULL)
     {
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ra_next = 0;
+      file->ra_end = 0;
+      file->ra_window = 0;
       return file;
     }
   else
     {
       inode_close (inode);
-      free (file);
+      slab_free (&file_cache, file);
       return NULL; 
     }
 }
@@ -49,7 +75,7 @@ file_close (struct file *file)
     {
       file_allow_write (file);
       inode_close (file->inode);
-      free (file); 
+      slab_free (&file_cache, file); 
     }
 }
 
@@ -68,11 +94,60 @@ file_get_inode (struct file *file)
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read;
+
+  readahead (file, size);
+  bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
   file->pos += bytes_read;
+  file->ra_next = file->pos;
   return bytes_read;
 }
 
+/* Called before FILE reads SIZE bytes at its current position.
+   If FILE is being read sequentially, starts reading the data
+   after those SIZE bytes into the buffer cache in the
+   background, so that it is there by the time FILE gets to it.
+   The read-ahead window doubles with each sequential read, up
+   to a limit, and closes as soon as FILE reads out of
+   sequence. */
+static void
+readahead (struct file *file, off_t size) 
+{
+  size_t max_window = READAHEAD_MAX;
+  off_t start, end;
+
+  if (file->pos != file->ra_next)
+    {
+      file->ra_window = 0;
+      file->ra_end = 0;
+      return;
+    }
+
+  /* Don't let read-ahead crowd everything else out of the
+     cache. */
+  if (max_window > cache_sector_cnt / 4)
+    max_window = cache_sector_cnt / 4;
+  if (file->ra_window == 0)
+    file->ra_window = READAHEAD_MIN;
+  else
+    file->ra_window *= 2;
+  if (file->ra_window > max_window)
+    file->ra_window = max_window;
+  if (file->ra_window == 0)
+    return;
+
+  /* Skip data we already asked for. */
+  start = file->pos + size;
+  end = start + file->ra_window * BLOCK_SECTOR_SIZE;
+  if (start < file->ra_end)
+    start = file->ra_end;
+  if (start < end)
+    {
+      inode_readahead (file->inode, end - start, start);
+      file->ra_end = end;
+    }
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually read,
@@ -87,9 +162,8 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk is full.
+   Writing past end of file extends the file.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
@@ -102,9 +176,8 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk is full.
+   Writing past end of file extends the file.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -113,6 +186,35 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Writes FILE's data to disk, returning once it is there. */
+void
+file_sync (struct file *file) 
+{
+  ASSERT (file != NULL);
+  inode_flush (file->inode);
+}
+
+/* Reads the next entry from FILE, which must be a directory,
+   and stores its name in NAME.  FILE's position is the position
+   within the directory.  Returns true if successful, false if
+   FILE is not a directory or has no more entries. */
+bool
+file_readdir (struct file *file, char name[NAME_MAX + 1]) 
+{
+  struct dir *dir;
+  bool success;
+
+  ASSERT (file != NULL);
+  dir = dir_open (inode_reopen (file->inode));
+  if (dir == NULL)
+    return false;
+  dir_seek (dir, file->pos);
+  success = dir_readdir (dir, name);
+  file->pos = dir_tell (dir);
+  dir_close (dir);
+  return success;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
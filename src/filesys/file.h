@@ -1,10 +1,14 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
+#include "filesys/directory.h"
 #include "filesys/off_t.h"
 
 struct inode;
 
+void file_init (void);
+
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
@@ -16,6 +20,8 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+void file_sync (struct file *);
+bool file_readdir (struct file *, char name[NAME_MAX + 1]);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
@@ -2,15 +2,20 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "threads/thread.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
 static void do_format (void);
+static struct dir *open_parent (const char *path, char name[NAME_MAX + 1]);
+static void discard_inode (block_sector_t);
 
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
@@ -21,7 +26,11 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  cache_init ();
   inode_init ();
+  file_init ();
+  dir_init ();
+  dcache_init ();
   free_map_init ();
 
   if (format) 
@@ -36,8 +45,16 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  cache_flush ();
 }
 
+/* Writes all of the file system's dirty data to disk. */
+void
+filesys_sync (void) 
+{
+  cache_flush ();
+}
+
 /* Creates a file named NAME with the given INITIAL_SIZE.
    Returns true if successful, false otherwise.
    Fails if a file named NAME already exists,
@@ -45,13 +62,45 @@ filesys_done (void)
 bool
 filesys_create (const char *name, off_t initial_size) 
 {
+  char file_name[NAME_MAX + 1];
   block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
+  struct dir *dir = open_parent (name, file_name);
+  bool created = false;
   bool success = (dir != NULL
                   && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
-  if (!success && inode_sector != 0) 
+                  && (created = inode_create (inode_sector, initial_size,
+                                              false))
+                  && dir_add (dir, file_name, inode_sector));
+  if (!success && created)
+    discard_inode (inode_sector);
+  else if (!success && inode_sector != 0) 
+    free_map_release (inode_sector, 1);
+  dir_close (dir);
+
+  return success;
+}
+
+/* Creates a directory named NAME.
+   Returns true if successful, false otherwise.
+   Fails if a file named NAME already exists,
+   or if internal memory allocation fails. */
+bool
+filesys_mkdir (const char *name) 
+{
+  char dir_name[NAME_MAX + 1];
+  block_sector_t inode_sector = 0;
+  struct dir *dir = open_parent (name, dir_name);
+  block_sector_t parent_sector = (dir != NULL
+                                  ? inode_get_inumber (dir_get_inode (dir))
+                                  : 0);
+  bool created = false;
+  bool success = (dir != NULL
+                  && free_map_allocate (1, &inode_sector)
+                  && (created = dir_create (inode_sector, 0, parent_sector))
+                  && dir_add (dir, dir_name, inode_sector));
+  if (!success && created)
+    discard_inode (inode_sector);
+  else if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
   dir_close (dir);
 
@@ -66,11 +115,12 @@ filesys_create (const char *name, off_t initial_size)
 struct file *
 filesys_open (const char *name)
 {
-  struct dir *dir = dir_open_root ();
+  char file_name[NAME_MAX + 1];
+  struct dir *dir = open_parent (name, file_name);
   struct inode *inode = NULL;
 
   if (dir != NULL)
-    dir_lookup (dir, name, &inode);
+    dir_lookup (dir, file_name, &inode);
   dir_close (dir);
 
   return file_open (inode);
@@ -78,25 +128,148 @@ filesys_open (const char *name)
 
 /* Deletes the file named NAME.
    Returns true if successful, false on failure.
-   Fails if no file named NAME exists,
-   or if an internal memory allocation fails. */
+   Fails if no file named NAME exists, if it is a directory that
+   is not empty, or if an internal memory allocation fails. */
 bool
 filesys_remove (const char *name) 
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  char file_name[NAME_MAX + 1];
+  struct dir *dir = open_parent (name, file_name);
+  bool success = dir != NULL && dir_remove (dir, file_name);
   dir_close (dir); 
 
   return success;
 }
-
+
+/* Makes the directory named NAME the current thread's working
+   directory.
+   Returns true if successful, false on failure.
+   Fails if no directory named NAME exists. */
+bool
+filesys_chdir (const char *name) 
+{
+  char dir_name[NAME_MAX + 1];
+  struct dir *dir = open_parent (name, dir_name);
+  struct inode *inode = NULL;
+  struct dir *cwd;
+
+  if (dir != NULL)
+    dir_lookup (dir, dir_name, &inode);
+  dir_close (dir);
+
+  cwd = dir_open (inode);
+  if (cwd == NULL)
+    return false;
+  dir_close (thread_current ()->cwd);
+  thread_current ()->cwd = cwd;
+  return true;
+}
+
+/* Extracts a file name part from *SRCP into PART, and updates
+   *SRCP so that the next call will return the next file name
+   part.  Returns 1 if successful, 0 at end of string, -1 for a
+   too-long file name part. */
+static int
+get_next_part (char part[NAME_MAX + 1], const char **srcp)
+{
+  const char *src = *srcp;
+  char *dst = part;
+
+  /* Skip leading slashes.  If it's all slashes, we're done. */
+  while (*src == '/')
+    src++;
+  if (*src == '\0')
+    return 0;
+
+  /* Copy up to NAME_MAX characters from SRC to DST.  Add null
+     terminator. */
+  while (*src != '/' && *src != '\0') 
+    {
+      if (dst < part + NAME_MAX)
+        *dst++ = *src;
+      else
+        return -1;
+      src++; 
+    }
+  *dst = '\0';
+
+  /* Advance source pointer. */
+  *srcp = src;
+  return 1;
+}
+
+/* Opens the directory that contains the last component of PATH,
+   which is relative to the current thread's working directory
+   unless it starts with "/", and copies that component into
+   NAME.  For "/", opens the root directory and sets NAME to ".".
+   Returns the directory, which the caller must close, or a null
+   pointer if PATH is empty or a directory along it does not
+   exist. */
+static struct dir *
+open_parent (const char *path, char name[NAME_MAX + 1])
+{
+  struct dir *cwd = thread_current ()->cwd;
+  char next[NAME_MAX + 1];
+  struct dir *dir;
+  int result;
+
+  if (*path == '\0')
+    return NULL;
+  if (*path == '/' || cwd == NULL)
+    dir = dir_open_root ();
+  else
+    dir = dir_reopen (cwd);
+
+  result = get_next_part (name, &path);
+  if (result == 0)
+    strlcpy (name, ".", NAME_MAX + 1);
+  while (result > 0 && dir != NULL)
+    {
+      struct inode *inode;
+
+      result = get_next_part (next, &path);
+      if (result == 0)
+        return dir;
+      else if (result < 0)
+        break;
+
+      /* Descend into NAME. */
+      dir_lookup (dir, name, &inode);
+      dir_close (dir);
+      dir = dir_open (inode);
+      strlcpy (name, next, NAME_MAX + 1);
+    }
+  if (result < 0)
+    {
+      dir_close (dir);
+      dir = NULL;
+    }
+  return dir;
+}
+
+/* Deletes the inode in SECTOR, which was just created but is not
+   in any directory, and frees its sectors. */
+static void
+discard_inode (block_sector_t sector)
+{
+  struct inode *inode = inode_open (sector);
+
+  if (inode != NULL)
+    {
+      inode_remove (inode);
+      inode_close (inode);
+    }
+  else
+    free_map_release (sector, 1);
+}
+
 /* Formats the file system. */
 static void
 do_format (void)
 {
   printf ("Formatting file system...");
   free_map_create ();
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  if (!dir_create (ROOT_DIR_SECTOR, 16, ROOT_DIR_SECTOR))
     PANIC ("root directory creation failed");
   free_map_close ();
   printf ("done.\n");
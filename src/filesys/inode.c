@@ -1,23 +1,83 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+
+/* Identifies an inode, and which of the two formats below it
+   uses to map its data. */
+#define INODE_MAGIC 0x494e4f44          /* Indexed. */
+#define EXTENT_MAGIC 0x45585446         /* Extent-based. */
+
+/* Create new inodes in extent-based format?  Set with the
+   -extents kernel option. */
+bool inode_use_extents;
+
+/* In an indexed inode, data sectors are found through a
+   multi-level index.  The first DIRECT_CNT sectors are listed in the inode
+   itself.  The next INDIRECT_CNT are listed in an indirect block,
+   a sector full of sector numbers, and the rest in the indirect
+   blocks listed in a doubly indirect block.  Sector 0 holds the
+   free map's inode, so it is never a data or index sector, and
+   a 0 entry means that no sector has been allocated there.
+
+   Sectors are allocated one at a time, as a write extends the
+   file, so a file need not be contiguous on disk. */
+#define DIRECT_CNT 123
+#define INDIRECT_CNT (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+#define DBL_INDIRECT_CNT (INDIRECT_CNT * INDIRECT_CNT)
+
+/* An extent-based inode instead describes its data as a list
+   of extents, runs of sectors that are contiguous on disk, so
+   that a file written sequentially onto a quiet disk needs only
+   a few entries however large it grows.  The first
+   INODE_EXTENT_CNT extents are stored in the inode.  The rest
+   are stored in extent blocks of EXTENTS_PER_BLOCK each, listed
+   in the inode's extent index block.
+
+   Rather than its length, an extent records END, the number of
+   file sectors up to and including it, so that the extent that
+   holds a given file sector can be found by binary search.  Its
+   length is END less the previous extent's END. */
+struct extent
+  {
+    block_sector_t start;               /* First sector on disk. */
+    uint32_t end;                       /* File sectors through here. */
+  };
 
-/* Identifies an inode. */
-#define INODE_MAGIC 0x494e4f44
+#define INODE_EXTENT_CNT 61
+#define EXTENTS_PER_BLOCK (BLOCK_SECTOR_SIZE / sizeof (struct extent))
 
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t is_dir;                    /* Nonzero for a directory. */
+    union
+      {
+        struct                          /* INODE_MAGIC. */
+          {
+            block_sector_t direct[DIRECT_CNT];  /* Direct data sectors. */
+            block_sector_t indirect;            /* Indirect block. */
+            block_sector_t dbl_indirect;        /* Doubly indirect block. */
+          };
+        struct                          /* EXTENT_MAGIC. */
+          {
+            uint32_t extent_cnt;                /* Number of extents. */
+            block_sector_t extent_index;        /* Extent index block. */
+            struct extent extents[INODE_EXTENT_CNT]; /* First extents. */
+            uint32_t unused[1];                 /* Not used. */
+          };
+      };
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -28,49 +88,480 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
-/* In-memory inode. */
-struct inode 
+/* The part of an in-memory inode that open inodes are looked
+   up by, separate so that a key to look up can be built on the
+   stack. */
+struct inode_key
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem hash_elem;         /* Element in open_inodes. */
     block_sector_t sector;              /* Sector number of disk location. */
+  };
+
+/* In-memory inode.
+
+   Reads of an inode's data hold DATA_LOCK shared, so that any
+   number of them, of the same inode or of different ones,
+   proceed at once.  Writes hold it exclusively for the part of
+   the write that is before end of file, so that a read sees all
+   or none of such a write.
+
+   A write past end of file also holds LENGTH_LOCK, which
+   serializes changes to the length and to the sector map.  No
+   reader looks past the length, so the part of the write past
+   end of file is done without DATA_LOCK, and the new length is
+   published only once the data is in place.
+
+   RWLOCK guards the contents of a directory as a whole (see
+   inode_lock()).  Directory operations read and write the
+   directory's data while holding it, so it is separate from
+   DATA_LOCK. */
+struct inode 
+  {
+    struct inode_key key;               /* Sector, and open_inodes element. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct rwlock rwlock;               /* Guards directory contents. */
+    struct rwlock data_lock;            /* Guards file data. */
+    struct lock length_lock;            /* Guards length and sector map. */
     struct inode_disk data;             /* Inode content. */
   };
 
+static block_sector_t index_to_sector (struct inode_disk *, size_t idx,
+                                       bool allocate);
+static block_sector_t extent_to_sector (struct inode_disk *, size_t idx);
+
+/* Returns the sector that holds data sector IDX of DISK, or 0 if
+   none has been allocated. */
+static block_sector_t
+map_sector (struct inode_disk *disk, size_t idx) 
+{
+  if (disk->magic == EXTENT_MAGIC)
+    return extent_to_sector (disk, idx);
+  else
+    return index_to_sector (disk, idx, false);
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
    POS. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos) 
 {
   ASSERT (inode != NULL);
   if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
+    return map_sector (&inode->data, pos / BLOCK_SECTOR_SIZE);
   else
     return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Fills SECTOR with zeros. */
+static void
+zero_sector (block_sector_t sector) 
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  cache_write (sector, zeros, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* If *SLOT is 0 and ALLOCATE is true, allocates a sector,
+   fills it with zeros, and stores its number in *SLOT.
+   Returns true if *SLOT names a sector afterward. */
+static bool
+fill_slot (block_sector_t *slot, bool allocate) 
+{
+  if (*slot == 0 && allocate && free_map_allocate (1, slot))
+    zero_sector (*slot);
+  return *slot != 0;
+}
+
+/* Returns entry IDX in index block BLOCK.  If the entry is 0
+   and ALLOCATE is true, allocates a zeroed sector for it first.
+   Returns 0 if there is no such sector. */
+static block_sector_t
+index_entry (block_sector_t block, size_t idx, bool allocate) 
+{
+  block_sector_t sector;
+
+  cache_read (block, &sector, idx * sizeof sector, sizeof sector);
+  if (sector == 0 && fill_slot (&sector, allocate))
+    cache_write (block, &sector, idx * sizeof sector, sizeof sector);
+  return sector;
+}
+
+/* Returns the sector that holds data sector IDX of DISK.  If it
+   has not been allocated and ALLOCATE is true, allocates it,
+   along with any index blocks needed to reach it, updating DISK
+   but not writing it back.  Returns 0 if there is no such
+   sector or allocation fails. */
+static block_sector_t
+index_to_sector (struct inode_disk *disk, size_t idx, bool allocate) 
+{
+  block_sector_t block;
+
+  if (idx < DIRECT_CNT)
+    return fill_slot (&disk->direct[idx], allocate) ? disk->direct[idx] : 0;
+  idx -= DIRECT_CNT;
+
+  if (idx < INDIRECT_CNT)
+    return (fill_slot (&disk->indirect, allocate)
+            ? index_entry (disk->indirect, idx, allocate) : 0);
+  idx -= INDIRECT_CNT;
+
+  if (idx < DBL_INDIRECT_CNT && fill_slot (&disk->dbl_indirect, allocate))
+    {
+      block = index_entry (disk->dbl_indirect, idx / INDIRECT_CNT, allocate);
+      if (block != 0)
+        return index_entry (block, idx % INDIRECT_CNT, allocate);
+    }
+  return 0;
+}
+
+/* Reads extent I of DISK into *E. */
+static void
+read_extent (struct inode_disk *disk, size_t i, struct extent *e) 
+{
+  if (i < INODE_EXTENT_CNT)
+    *e = disk->extents[i];
+  else
+    {
+      size_t j = i - INODE_EXTENT_CNT;
+      block_sector_t block = index_entry (disk->extent_index,
+                                          j / EXTENTS_PER_BLOCK, false);
+      cache_read (block, e, j % EXTENTS_PER_BLOCK * sizeof *e, sizeof *e);
+    }
+}
+
+/* Stores E as extent I of DISK, allocating an extent block
+   for it if necessary.  Returns true if successful, false if
+   the disk is full or DISK has no room for another extent
+   block. */
+static bool
+write_extent (struct inode_disk *disk, size_t i, const struct extent *e) 
+{
+  if (i < INODE_EXTENT_CNT)
+    disk->extents[i] = *e;
+  else
+    {
+      size_t j = i - INODE_EXTENT_CNT;
+      block_sector_t block;
+
+      if (j / EXTENTS_PER_BLOCK >= INDIRECT_CNT
+          || !fill_slot (&disk->extent_index, true))
+        return false;
+      block = index_entry (disk->extent_index, j / EXTENTS_PER_BLOCK, true);
+      if (block == 0)
+        return false;
+      cache_write (block, e, j % EXTENTS_PER_BLOCK * sizeof *e, sizeof *e);
+    }
+  return true;
+}
+
+/* Returns the file sector at which extent I of DISK begins. */
+static uint32_t
+extent_begin (struct inode_disk *disk, size_t i) 
+{
+  struct extent prev;
+
+  if (i == 0)
+    return 0;
+  read_extent (disk, i - 1, &prev);
+  return prev.end;
+}
+
+/* Returns the sector that holds data sector IDX of DISK, which
+   must be in extent-based format, or 0 if there is none. */
+static block_sector_t
+extent_to_sector (struct inode_disk *disk, size_t idx) 
+{
+  size_t lo = 0, hi = disk->extent_cnt;
+  struct extent e;
+
+  /* Find the first extent that ends after IDX. */
+  while (lo < hi) 
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      read_extent (disk, mid, &e);
+      if (e.end <= idx)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  if (lo >= disk->extent_cnt)
+    return 0;
+
+  read_extent (disk, lo, &e);
+  return e.start + (idx - extent_begin (disk, lo));
+}
+
+/* Allocates up to CNT consecutive sectors, starting at *START
+   if AT_START is true, or wherever they fit otherwise, and
+   stores the first in *START.  Tries smaller runs if CNT
+   sectors are not available.  Returns the number of sectors
+   allocated, which is 0 if none were. */
+static size_t
+allocate_run (size_t cnt, block_sector_t *start, bool at_start) 
+{
+  for (; cnt > 0; cnt /= 2)
+    if (at_start
+        ? free_map_allocate_at (*start, cnt)
+        : free_map_allocate (cnt, start))
+      return cnt;
+  return 0;
+}
+
+/* Allocates the sectors that DISK, which must be in
+   extent-based format, needs to hold LENGTH bytes, preferring
+   to grow its last extent in place.  Returns true if
+   successful, false if the disk is full or DISK has too many
+   extents. */
+static bool
+extent_extend (struct inode_disk *disk, off_t length) 
+{
+  uint32_t need = bytes_to_sectors (length);
+  uint32_t have = 0;
+  block_sector_t next = 0;
+  struct extent last;
+
+  if (disk->extent_cnt > 0) 
+    {
+      read_extent (disk, disk->extent_cnt - 1, &last);
+      have = last.end;
+      next = last.start + (last.end - extent_begin (disk,
+                                                    disk->extent_cnt - 1));
+    }
+
+  while (have < need) 
+    {
+      block_sector_t start = next;
+      size_t cnt, i;
+
+      /* Grow the last extent if the sectors after it are free,
+         otherwise start a new one. */
+      if (disk->extent_cnt > 0
+          && (cnt = allocate_run (need - have, &start, true)) > 0)
+        {
+          last.end += cnt;
+          write_extent (disk, disk->extent_cnt - 1, &last);
+        }
+      else 
+        {
+          cnt = allocate_run (need - have, &start, false);
+          if (cnt == 0)
+            return false;
+          last.start = start;
+          last.end = have + cnt;
+          if (!write_extent (disk, disk->extent_cnt, &last)) 
+            {
+              free_map_release (start, cnt);
+              return false;
+            }
+          disk->extent_cnt++;
+        }
+
+      for (i = 0; i < cnt; i++)
+        zero_sector (start + i);
+      have += cnt;
+      next = start + cnt;
+    }
+  return true;
+}
+
+/* Allocates the sectors that DISK needs to hold LENGTH bytes.
+   Returns true if successful, false if the disk is full.  In
+   either case DISK is updated to refer to the sectors that were
+   allocated, but its length is not changed. */
+static bool
+extend (struct inode_disk *disk, off_t length) 
+{
+  size_t idx;
+
+  if (disk->magic == EXTENT_MAGIC)
+    return extent_extend (disk, length);
+
+  for (idx = bytes_to_sectors (disk->length);
+       idx < bytes_to_sectors (length); idx++)
+    if (index_to_sector (disk, idx, true) == 0)
+      return false;
+  return true;
+}
+
+/* Function called on a run of CNT sectors starting at SECTOR by
+   walk_sectors(), with the AUX passed to walk_sectors(). */
+typedef void run_func (block_sector_t sector, size_t cnt, void *aux);
+
+/* Calls FUNC on BLOCK and, if LEVEL > 0, on every sector
+   reachable from index block BLOCK through LEVEL levels of
+   index blocks, one sector at a time.  A sector's children are
+   visited before the sector itself.  Does nothing if BLOCK is
+   0. */
+static void
+walk_index (block_sector_t block, int level, run_func *func, void *aux) 
+{
+  size_t i;
+
+  if (block == 0)
+    return;
+  if (level > 0)
+    for (i = 0; i < INDIRECT_CNT; i++)
+      walk_index (index_entry (block, i, false), level - 1, func, aux);
+  func (block, 1, aux);
+}
+
+/* Calls FUNC on every data and index sector that DISK refers
+   to, including sectors past its end left by a failed
+   extend(), passing AUX along.  Each extent is passed to FUNC as
+   a single run. */
+static void
+walk_sectors (struct inode_disk *disk, run_func *func, void *aux) 
+{
+  size_t i;
+
+  if (disk->magic == EXTENT_MAGIC)
+    {
+      for (i = 0; i < disk->extent_cnt; i++) 
+        {
+          struct extent e;
+
+          read_extent (disk, i, &e);
+          func (e.start, e.end - extent_begin (disk, i), aux);
+        }
+      walk_index (disk->extent_index, 1, func, aux);
+    }
+  else 
+    {
+      for (i = 0; i < DIRECT_CNT; i++)
+        walk_index (disk->direct[i], 0, func, aux);
+      walk_index (disk->indirect, 1, func, aux);
+      walk_index (disk->dbl_indirect, 2, func, aux);
+    }
+}
+
+/* Releases the CNT sectors starting at SECTOR in the free map. */
+static void
+release_run (block_sector_t sector, size_t cnt, void *aux UNUSED) 
+{
+  free_map_release (sector, cnt);
+}
+
+/* A growable list of sector runs. */
+struct run_list
+  {
+    struct sector_run *runs;    /* Runs, merged where adjacent. */
+    size_t cnt;                 /* Number of runs. */
+    size_t capacity;            /* Number of elements in RUNS. */
+    bool overflow;              /* Out of memory for RUNS? */
+  };
+
+/* Adds the CNT sectors starting at SECTOR to run_list LIST_,
+   extending the last run instead if they follow it. */
+static void
+add_run (block_sector_t sector, size_t cnt, void *list_) 
+{
+  struct run_list *list = list_;
+  struct sector_run *last = list->cnt > 0 ? &list->runs[list->cnt - 1] : NULL;
+
+  if (cnt == 0 || list->overflow)
+    return;
+  if (last != NULL && last->start + last->cnt == sector)
+    {
+      last->cnt += cnt;
+      return;
+    }
+  if (list->cnt >= list->capacity)
+    {
+      size_t capacity = list->capacity > 0 ? list->capacity * 2 : 16;
+      struct sector_run *runs = realloc (list->runs,
+                                         capacity * sizeof *runs);
+      if (runs == NULL)
+        {
+          list->overflow = true;
+          return;
+        }
+      list->runs = runs;
+      list->capacity = capacity;
+    }
+  list->runs[list->cnt].start = sector;
+  list->runs[list->cnt].cnt = cnt;
+  list->cnt++;
+}
+
+/* Open inodes, hashed by sector, so that opening a single inode
+   twice returns the same `struct inode'.  Opens only search the
+   table, so they share OPEN_INODES_LOCK; adding or removing an
+   inode takes it exclusively. */
+static struct hash open_inodes;
+static struct rwlock open_inodes_lock;
+
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
+
+/* In-memory inodes. */
+static struct slab_cache inode_cache;
+
+/* Constructor for inode_cache.  The locks are free again by the
+   time an inode is freed, so they only need initializing once. */
+static void
+inode_ctor (void *inode_) 
+{
+  struct inode *inode = inode_;
+  rwlock_init (&inode->rwlock);
+  rwlock_init (&inode->data_lock);
+  lock_init (&inode->length_lock);
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+    PANIC ("could not allocate open inode table");
+  rwlock_init (&open_inodes_lock);
+  slab_cache_init (&inode_cache, "inode", sizeof (struct inode), inode_ctor);
+}
+
+/* Returns the open inode for SECTOR, reopening it, or a null
+   pointer if SECTOR is not open.  OPEN_INODES_LOCK must be held
+   in either mode. */
+static struct inode *
+find_open_inode (block_sector_t sector)
+{
+  struct inode_key key;
+  struct hash_elem *e;
+
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.hash_elem);
+  if (e == NULL)
+    return NULL;
+  return inode_reopen (hash_entry (e, struct inode, key.hash_elem));
+}
+
+/* Returns a hash of the sector of inode key K_. */
+static unsigned
+inode_hash (const struct hash_elem *k_, void *aux UNUSED)
+{
+  const struct inode_key *k = hash_entry (k_, struct inode_key, hash_elem);
+  return hash_int (k->sector);
 }
 
-/* Initializes an inode with LENGTH bytes of data and
-   writes the new inode to sector SECTOR on the file system
-   device.
+/* Orders inode keys by sector. */
+static bool
+inode_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct inode_key *a = hash_entry (a_, struct inode_key, hash_elem);
+  const struct inode_key *b = hash_entry (b_, struct inode_key, hash_elem);
+  return a->sector < b->sector;
+}
+
+/* Initializes an inode with LENGTH bytes of data, marked as a
+   directory if IS_DIR is true, and writes the new inode to
+   sector SECTOR on the file system device.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
 bool
-inode_create (block_sector_t sector, off_t length)
+inode_create (block_sector_t sector, off_t length, bool is_dir)
 {
   struct inode_disk *disk_inode = NULL;
   bool success = false;
@@ -84,22 +575,16 @@ inode_create (block_sector_t sector, off_t length)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
-      disk_inode->length = length;
-      disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      disk_inode->magic = inode_use_extents ? EXTENT_MAGIC : INODE_MAGIC;
+      disk_inode->is_dir = is_dir;
+      if (extend (disk_inode, length)) 
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
+          disk_inode->length = length;
+          cache_write (sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
           success = true; 
         } 
+      else
+        walk_sectors (disk_inode, release_run, NULL);
       free (disk_inode);
     }
   return success;
@@ -111,33 +596,39 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
-  struct inode *inode;
+  struct inode *inode, *open;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  rwlock_acquire_read (&open_inodes_lock);
+  inode = find_open_inode (sector);
+  rwlock_release_read (&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = slab_alloc (&inode_cache);
   if (inode == NULL)
     return NULL;
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
-  inode->sector = sector;
+  inode->key.sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  cache_read (inode->key.sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+
+  /* Another thread may have opened the same inode while we were
+     reading it in.  If so, use that one instead. */
+  rwlock_acquire_write (&open_inodes_lock);
+  open = find_open_inode (sector);
+  if (open == NULL)
+    hash_insert (&open_inodes, &inode->key.hash_elem);
+  rwlock_release_write (&open_inodes_lock);
+  if (open != NULL)
+    {
+      slab_free (&inode_cache, inode);
+      inode = open;
+    }
   return inode;
 }
 
@@ -146,7 +637,12 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      /* Concurrent opens hold OPEN_INODES_LOCK only for reading. */
+      enum intr_level old_level = intr_disable ();
+      inode->open_cnt++;
+      intr_set_level (old_level);
+    }
   return inode;
 }
 
@@ -154,7 +650,7 @@ inode_reopen (struct inode *inode)
 block_sector_t
 inode_get_inumber (const struct inode *inode)
 {
-  return inode->sector;
+  return inode->key.sector;
 }
 
 /* Closes INODE and writes it to disk. (Does it?  Check code.)
@@ -163,28 +659,55 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  enum intr_level old_level;
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
+  /* Holding OPEN_INODES_LOCK for writing keeps inode_open() from
+     finding and reviving INODE once its count has reached zero.
+     inode_reopen() does not take the lock, hence the atomic
+     decrement. */
+  rwlock_acquire_write (&open_inodes_lock);
+  old_level = intr_disable ();
+  last = --inode->open_cnt == 0;
+  intr_set_level (old_level);
+  if (last)
+    hash_delete (&open_inodes, &inode->key.hash_elem);
+  rwlock_release_write (&open_inodes_lock);
+
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
-          free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          walk_sectors (&inode->data, release_run, NULL);
+          free_map_release (inode->key.sector, 1);
         }
 
-      free (inode); 
+      slab_free (&inode_cache, inode);
     }
 }
 
+/* Returns true if INODE is a directory. */
+bool
+inode_is_dir (const struct inode *inode) 
+{
+  return inode->data.is_dir != 0;
+}
+
+/* Returns true if INODE has been removed, that is, it will be
+   deleted when it is closed by the last caller who has it
+   open. */
+bool
+inode_is_removed (const struct inode *inode) 
+{
+  return inode->removed;
+}
+
 /* Marks INODE to be deleted when it is closed by the last caller who
    has it open. */
 void
@@ -202,8 +725,8 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
 
+  rwlock_acquire_read (&inode->data_lock);
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
@@ -220,110 +743,150 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+  rwlock_release_read (&inode->data_lock);
 
   return bytes_read;
 }
 
+/* Starts reading the sectors that hold the SIZE bytes of INODE
+   at OFFSET into the buffer cache, without waiting for them.
+   Sectors past the end of INODE are ignored. */
+void
+inode_readahead (struct inode *inode, off_t size, off_t offset) 
+{
+  off_t end = offset + size;
+  off_t pos;
+
+  if (end > inode_length (inode))
+    end = inode_length (inode);
+  for (pos = offset - offset % BLOCK_SECTOR_SIZE; pos < end;
+       pos += BLOCK_SECTOR_SIZE)
+    cache_readahead (byte_to_sector (inode, pos));
+}
+
+/* Writes the bytes of INODE from START up to END, whose sectors
+   must already be allocated, from BUFFER.  Returns the number of
+   bytes written. */
+static off_t
+write_range (struct inode *inode, const uint8_t *buffer, off_t start,
+             off_t end) 
+{
+  off_t pos = start;
+
+  while (pos < end) 
+    {
+      /* Sector to write, starting byte offset within sector, and
+         number of bytes to write into it. */
+      block_sector_t sector_idx = map_sector (&inode->data,
+                                              pos / BLOCK_SECTOR_SIZE);
+      int sector_ofs = pos % BLOCK_SECTOR_SIZE;
+      int chunk_size = BLOCK_SECTOR_SIZE - sector_ofs;
+      if (chunk_size > end - pos)
+        chunk_size = end - pos;
+
+      cache_write (sector_idx, buffer + (pos - start), sector_ofs,
+                   chunk_size);
+      pos += chunk_size;
+    }
+  return end - start;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if an error occurs.  A write past end of file
+   extends INODE, filling any gap with zeros; if the disk is too
+   full for that, only the bytes before end of file are
+   written. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  off_t length, end;
+  bool extending;
 
-  if (inode->deny_write_cnt)
+  if (inode->deny_write_cnt || size <= 0)
     return 0;
 
-  while (size > 0) 
+  /* A write past end of file allocates all the sectors it needs
+     before writing anything. */
+  end = offset + size;
+  length = inode_length (inode);
+  extending = end > length;
+  if (extending)
     {
-      /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
-      int sector_ofs = offset % BLOCK_SECTOR_SIZE;
-
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
-      int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
+      lock_acquire (&inode->length_lock);
+      length = inode_length (inode);
+      if (end > length && !extend (&inode->data, end))
+        end = length;
+    }
 
-      /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
-        break;
+  /* Write the part before end of file with readers locked out. */
+  if (offset < length) 
+    {
+      rwlock_acquire_write (&inode->data_lock);
+      bytes_written += write_range (inode, buffer, offset,
+                                    end < length ? end : length);
+      rwlock_release_write (&inode->data_lock);
+    }
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+  /* Write the rest, which no reader can see until the new length
+     is set. */
+  if (extending)
+    {
+      if (end > length)
         {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          off_t start = offset > length ? offset : length;
+          bytes_written += write_range (inode, buffer + (start - offset),
+                                        start, end);
+          inode->data.length = end;
         }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
-
-      /* Advance. */
-      size -= chunk_size;
-      offset += chunk_size;
-      bytes_written += chunk_size;
+      cache_write (inode->key.sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+      lock_release (&inode->length_lock);
     }
-  free (bounce);
 
   return bytes_written;
 }
 
+/* Writes INODE's data and index blocks, and INODE itself, to
+   disk if they are dirty in the buffer cache, returning once
+   they are there.  They are written together, in order of
+   sector number, so that adjacent sectors go out as one
+   request.  If there is not enough memory to list them, the
+   whole cache is written instead. */
+void
+inode_flush (struct inode *inode) 
+{
+  struct run_list list = { NULL, 0, 0, false };
+
+  lock_acquire (&inode->length_lock);
+  walk_sectors (&inode->data, add_run, &list);
+  add_run (inode->key.sector, 1, &list);
+  if (!list.overflow)
+    cache_flush_runs (list.runs, list.cnt);
+  else
+    cache_flush ();
+  lock_release (&inode->length_lock);
+  free (list.runs);
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
 inode_deny_write (struct inode *inode) 
 {
+  enum intr_level old_level = intr_disable ();
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  intr_set_level (old_level);
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +895,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  enum intr_level old_level = intr_disable ();
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  intr_set_level (old_level);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -343,3 +908,33 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Locks INODE's contents for reading, e.g. for a directory
+   lookup.  Any number of threads may do so at once. */
+void
+inode_lock_shared (struct inode *inode)
+{
+  rwlock_acquire_read (&inode->rwlock);
+}
+
+/* Releases a shared lock on INODE's contents. */
+void
+inode_unlock_shared (struct inode *inode)
+{
+  rwlock_release_read (&inode->rwlock);
+}
+
+/* Locks INODE's contents for modification, excluding all other
+   readers and writers. */
+void
+inode_lock (struct inode *inode)
+{
+  rwlock_acquire_write (&inode->rwlock);
+}
+
+/* Releases an exclusive lock on INODE's contents. */
+void
+inode_unlock (struct inode *inode)
+{
+  rwlock_release_write (&inode->rwlock);
+}
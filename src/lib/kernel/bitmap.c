@@ -23,11 +23,21 @@ typedef unsigned long elem_type;
 
 /* From the outside, a bitmap is an array of bits.  From the
    inside, it's an array of elem_type (defined above) that
-   simulates an array of bits. */
+   simulates an array of bits.
+
+   Bitmaps are mostly used to find free resources, so we also
+   remember a "hint": every bit below it is known to be true,
+   so searches for false bits can start there.  Clearing a bit
+   below the hint moves the hint down; searching for false bits
+   with bitmap_scan_and_flip() moves it up.  Like the bits
+   themselves, the hint is not protected against concurrent
+   modification; callers that change a bitmap from more than
+   one thread must serialize those changes. */
 struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
     elem_type *bits;    /* Elements that represent bits. */
+    size_t hint;        /* All bits below this index are true. */
   };
 
 /* Returns the index of the element that contains the bit
@@ -60,6 +70,46 @@ byte_cnt (size_t bit_cnt)
   return sizeof (elem_type) * elem_cnt (bit_cnt);
 }
 
+/* Returns an elem_type in which bits FIRST through LAST,
+   inclusive, counting from the least significant bit, are set
+   and the rest are clear.  FIRST <= LAST < ELEM_BITS. */
+static inline elem_type
+range_mask (size_t first, size_t last) 
+{
+  elem_type high = last + 1 < ELEM_BITS
+                   ? ((elem_type) 1 << (last + 1)) - 1
+                   : (elem_type) -1;
+  return high & ~(((elem_type) 1 << first) - 1);
+}
+
+/* Returns element IDX of B, inverted if VALUE is false, so that
+   1 bits in the result are bits that are set to VALUE. */
+static inline elem_type
+elem_matching (const struct bitmap *b, size_t idx, bool value) 
+{
+  return value ? b->bits[idx] : ~b->bits[idx];
+}
+
+/* Returns the number of 1 bits in X.
+   (__builtin_popcount() would need a libgcc helper, which the
+   kernel does not link against, on CPUs without POPCNT.) */
+static inline size_t
+count_ones (elem_type x) 
+{
+  x = x - ((x >> 1) & 0x55555555);
+  x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+  x = (x + (x >> 4)) & 0x0f0f0f0f;
+  return (x * 0x01010101) >> 24;
+}
+
+/* Notes that bit BIT_IDX in B has been set to false. */
+static inline void
+lower_hint (struct bitmap *b, size_t bit_idx) 
+{
+  if (bit_idx < b->hint)
+    b->hint = bit_idx;
+}
+
 /* Returns a bit mask in which the bits actually used in the last
    element of B's bits are set to 1 and the rest are set to 0. */
 static inline elem_type
@@ -83,6 +133,7 @@ bitmap_create (size_t bit_cnt)
     {
       b->bit_cnt = bit_cnt;
       b->bits = malloc (byte_cnt (bit_cnt));
+      b->hint = 0;
       if (b->bits != NULL || bit_cnt == 0)
         {
           bitmap_set_all (b, false);
@@ -105,6 +156,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 
   b->bit_cnt = bit_cnt;
   b->bits = (elem_type *) (b + 1);
+  b->hint = 0;
   bitmap_set_all (b, false);
   return b;
 }
@@ -177,6 +229,7 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the AND instruction in [IA32-v2a]. */
   asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  lower_hint (b, bit_idx);
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -192,6 +245,10 @@ bitmap_flip (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the XOR instruction in [IA32-v2b]. */
   asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+
+  /* Every bit below the hint is true, so flipping one makes it
+     false. */
+  lower_hint (b, bit_idx);
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -214,18 +271,35 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Whole elements are written at once; only the partial
+   elements at either end need a read-modify-write. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t first, last, i;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  if (cnt == 0)
+    return;
+  if (!value)
+    lower_hint (b, start);
+
+  first = elem_idx (start);
+  last = elem_idx (start + cnt - 1);
+  for (i = first; i <= last; i++)
+    {
+      elem_type mask = range_mask (i == first ? start % ELEM_BITS : 0,
+                                   i == last ? (start + cnt - 1) % ELEM_BITS
+                                             : ELEM_BITS - 1);
+      if (value)
+        b->bits[i] |= mask;
+      else
+        b->bits[i] &= ~mask;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -233,34 +307,67 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t first, last, i, value_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
+  if (cnt == 0)
+    return 0;
+
   value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
+  first = elem_idx (start);
+  last = elem_idx (start + cnt - 1);
+  for (i = first; i <= last; i++)
+    {
+      elem_type mask = range_mask (i == first ? start % ELEM_BITS : 0,
+                                   i == last ? (start + cnt - 1) % ELEM_BITS
+                                             : ELEM_BITS - 1);
+      value_cnt += count_ones (elem_matching (b, i, value) & mask);
+    }
   return value_cnt;
 }
 
+/* Returns the index of the first bit in B at or after START,
+   and before END, that is set to VALUE, or END if there is no
+   such bit.  END must not exceed B's size.  Skips elements in
+   which no bit is set to VALUE and finds the bit within an
+   element by counting trailing zeros. */
+static size_t
+find_next (const struct bitmap *b, size_t start, size_t end, bool value) 
+{
+  size_t i;
+
+  if (start >= end)
+    return end;
+
+  i = elem_idx (start);
+  for (;;)
+    {
+      elem_type bits = elem_matching (b, i, value);
+      if (i == elem_idx (start))
+        bits &= ~(((elem_type) 1 << (start % ELEM_BITS)) - 1);
+      if (bits != 0)
+        {
+          size_t idx = i * ELEM_BITS + __builtin_ctzl (bits);
+          return idx < end ? idx : end;
+        }
+      if (++i * ELEM_BITS >= end)
+        return end;
+    }
+}
+
 /* Returns true if any bits in B between START and START + CNT,
    exclusive, are set to VALUE, and false otherwise. */
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return find_next (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -289,6 +396,37 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 
 /* Finding set or unset bits. */
 
+/* Finds the first group of CNT consecutive bits in B at or
+   after START that are all set to VALUE, and returns the index
+   of its first bit, or BITMAP_ERROR if there is none.  Stores
+   into *FIRST the index of the first bit at or after START that
+   is set to VALUE, or B's size if there is none.  CNT must be
+   nonzero. */
+static size_t
+scan (const struct bitmap *b, size_t start, size_t cnt, bool value,
+      size_t *first) 
+{
+  size_t i = start;
+
+  *first = BITMAP_ERROR;
+  for (;;)
+    {
+      size_t run_start, run_end;
+
+      /* Find the start of the next run of VALUE bits, then the
+         end of that run, looking no further than we need to. */
+      run_start = find_next (b, i, b->bit_cnt, value);
+      if (*first == BITMAP_ERROR)
+        *first = run_start;
+      if (run_start + cnt > b->bit_cnt)
+        return BITMAP_ERROR;
+      run_end = find_next (b, run_start, run_start + cnt, !value);
+      if (run_end == run_start + cnt)
+        return run_start;
+      i = run_end;
+    }
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -296,18 +434,18 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
+  size_t first;
+
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
-    {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
-    }
-  return BITMAP_ERROR;
+  if (cnt > b->bit_cnt)
+    return BITMAP_ERROR;
+  if (cnt == 0)
+    return start;
+  if (!value && start < b->hint)
+    start = b->hint;
+  return scan (b, start, cnt, value, &first);
 }
 
 /* Finds the first group of CNT consecutive bits in B at or after
@@ -320,12 +458,31 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
 {
-  size_t idx = bitmap_scan (b, start, cnt, value);
+  size_t idx, first;
+  bool from_hint;
+
+  ASSERT (b != NULL);
+  ASSERT (start <= b->bit_cnt);
+
+  if (cnt > b->bit_cnt)
+    return BITMAP_ERROR;
+  if (cnt == 0)
+    return start;
+
+  from_hint = !value && start <= b->hint;
+  if (from_hint)
+    start = b->hint;
+  idx = scan (b, start, cnt, value, &first);
   if (idx != BITMAP_ERROR) 
     bitmap_set_multiple (b, idx, cnt, !value);
+
+  /* Every bit from the old hint up to FIRST is true, and if
+     the group we just set starts at FIRST, so is the group. */
+  if (from_hint)
+    b->hint = idx == first ? idx + cnt : first;
   return idx;
 }
-
+
 /* File input and output. */
 
 #ifdef FILESYS
@@ -347,6 +504,7 @@ bitmap_read (struct bitmap *b, struct file *file)
       off_t size = byte_cnt (b->bit_cnt);
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+      b->hint = 0;
     }
   return success;
 }
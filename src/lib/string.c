@@ -1,5 +1,31 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* The block functions below move a 32-bit word at a time, using
+   the x86 string instructions where they fit.  The direction
+   flag is clear on entry to every function, as the calling
+   convention requires (intr_entry clears it for interrupt
+   handlers too), and any code that sets it clears it again
+   before returning.
+
+   A word type that may alias any other type, so that byte
+   buffers can be read a word at a time. */
+typedef uint32_t __attribute__ ((__may_alias__)) word_t;
+
+/* A word with every byte set to 0x01 and one with every byte set
+   to 0x80, for the "has zero byte" test below. */
+#define ONES ((word_t) 0x01010101)
+#define HIGHS ((word_t) 0x80808080)
+
+/* Returns nonzero if any byte in W is zero.  Subtracting 1 from
+   each byte borrows into the high bit only for bytes that were
+   0 (or at least 0x80, which ~W rules out). */
+static inline word_t
+has_zero_byte (word_t w) 
+{
+  return (w - ONES) & ~w & HIGHS;
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,8 +38,23 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  while (size-- > 0)
-    *dst++ = *src++;
+  if (size >= 2 * sizeof (word_t)) 
+    {
+      /* Copy bytes until DST is word-aligned, then words, then
+         whatever bytes are left over. */
+      size_t head = -(uintptr_t) dst % sizeof (word_t);
+      size_t words = (size - head) / sizeof (word_t);
+      size_t tail = (size - head) % sizeof (word_t);
+
+      asm volatile ("rep movsb; movl %3, %%ecx; rep movsl; "
+                    "movl %4, %%ecx; rep movsb"
+                    : "+D" (dst), "+S" (src), "+c" (head)
+                    : "g" (words), "g" (tail)
+                    : "memory");
+    }
+  else 
+    while (size-- > 0)
+      *dst++ = *src++;
 
   return dst_;
 }
@@ -29,10 +70,29 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  if (dst < src) 
+  if (dst <= src || dst >= src + size) 
     {
-      while (size-- > 0)
-        *dst++ = *src++;
+      /* Copying upward is safe: each word is read before the
+         copy reaches it. */
+      memcpy (dst, src, size);
+    }
+  else if (size >= sizeof (word_t)) 
+    {
+      /* Copy downward from the end: the odd bytes at the end
+         first, then the words.  The direction flag must be
+         cleared before any compiled code runs again, so it is
+         all one asm statement. */
+      size_t words = size / sizeof (word_t);
+      size_t tail = size % sizeof (word_t);
+
+      dst += size - 1;
+      src += size - 1;
+      asm volatile ("std; rep movsb; "
+                    "subl $3, %%edi; subl $3, %%esi; "
+                    "movl %3, %%ecx; rep movsl; cld"
+                    : "+D" (dst), "+S" (src), "+c" (tail)
+                    : "g" (words)
+                    : "memory", "cc");
     }
   else 
     {
@@ -42,7 +102,7 @@ memmove (void *dst_, const void *src_, size_t size)
         *--dst = *--src;
     }
 
-  return dst;
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -58,6 +118,14 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  /* Skip over equal words, then find the differing byte. */
+  for (; size >= sizeof (word_t); size -= sizeof (word_t))
+    {
+      if (*(const word_t *) a != *(const word_t *) b)
+        break;
+      a += sizeof (word_t);
+      b += sizeof (word_t);
+    }
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -98,6 +166,18 @@ memchr (const void *block_, int ch_, size_t size)
 
   ASSERT (block != NULL || size == 0);
 
+  /* Check bytes until BLOCK is aligned, then a word at a time:
+     a byte equal to CH becomes zero when XORed with CH in every
+     byte. */
+  for (; size > 0 && (uintptr_t) block % sizeof (word_t) != 0; size--, block++)
+    if (*block == ch)
+      return (void *) block;
+  for (; size >= sizeof (word_t); size -= sizeof (word_t))
+    {
+      if (has_zero_byte (*(const word_t *) block ^ (ch * ONES)))
+        break;
+      block += sizeof (word_t);
+    }
   for (; size-- > 0; block++)
     if (*block == ch)
       return (void *) block;
@@ -278,20 +358,29 @@ strtok_r (char *s, const char *delimiters, char **save_ptr)
 void *
 memset (void *dst_, int value, size_t size) 
 {
-  //printf("++++++++++++ 1\n");
   unsigned char *dst = dst_;
 
-  //printf("++++++++++++ 2\n");
   ASSERT (dst != NULL || size == 0);
-  
-  //printf("++++++++++++ 3\n");
-  while (size-- > 0)
-  {
-    *dst++ = value;
-  }
-  
 
-  //printf("++++++++++++ 4\n");
+  if (size >= 2 * sizeof (word_t)) 
+    {
+      /* Store bytes until DST is word-aligned, then words, then
+         whatever bytes are left over. */
+      word_t fill = (unsigned char) value * ONES;
+      size_t head = -(uintptr_t) dst % sizeof (word_t);
+      size_t words = (size - head) / sizeof (word_t);
+      size_t tail = (size - head) % sizeof (word_t);
+
+      asm volatile ("rep stosb; movl %3, %%ecx; rep stosl; "
+                    "movl %4, %%ecx; rep stosb"
+                    : "+D" (dst), "+c" (head)
+                    : "a" (fill), "g" (words), "g" (tail)
+                    : "memory");
+    }
+  else 
+    while (size-- > 0)
+      *dst++ = value;
+
   return dst_;
 }
 
@@ -303,8 +392,16 @@ strlen (const char *string)
 
   ASSERT (string != NULL);
 
-  for (p = string; *p != '\0'; p++)
-    continue;
+  /* Check bytes until P is aligned, then a word at a time.  An
+     aligned word never straddles a page boundary, so reading
+     past the terminator within its word cannot fault. */
+  for (p = string; (uintptr_t) p % sizeof (word_t) != 0; p++)
+    if (*p == '\0')
+      return p - string;
+  while (!has_zero_byte (*(const word_t *) p))
+    p += sizeof (word_t);
+  while (*p != '\0')
+    p++;
   return p - string;
 }
 
@@ -0,0 +1,50 @@
+/* Child process for par-read test.
+   Reads one of the test files a sector at a time, PASS_CNT
+   times over, checking the contents as it goes. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/par-read.h"
+
+const char *test_name = "child-par-read";
+
+static char buf[BUF_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  const char *file_name;
+  int child_idx;
+  int fd;
+  int pass;
+
+  quiet = true;
+  
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  file_name = file_names[child_idx % 2];
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (pass = 0; pass < PASS_CNT; pass++) 
+    {
+      size_t ofs;
+
+      seek (fd, 0);
+      for (ofs = 0; ofs < sizeof buf; ofs += CHUNK_SIZE)
+        {
+          char chunk[CHUNK_SIZE];
+          CHECK (read (fd, chunk, CHUNK_SIZE) == CHUNK_SIZE,
+                 "read \"%s\"", file_name);
+          compare_bytes (chunk, buf + ofs, CHUNK_SIZE, ofs, file_name);
+        }
+    }
+  close (fd);
+
+  return child_idx;
+}
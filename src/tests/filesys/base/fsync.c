@@ -0,0 +1,35 @@
+/* Writes a file, forces it to disk with fsync and sync, and
+   verifies that its contents are unchanged afterward. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+char buf1[5678];
+char buf2[5678];
+
+void
+test_main (void) 
+{
+  const char *file_name = "syncme";
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf1, sizeof buf1);
+  CHECK (write (fd, buf1, sizeof buf1) == sizeof buf1,
+         "write \"%s\"", file_name);
+  CHECK (fsync (fd), "fsync \"%s\"", file_name);
+  CHECK (!fsync (fd + 100), "fsync bad fd (must fail)");
+  msg ("sync");
+  sync ();
+  msg ("seek \"%s\" to 0", file_name);
+  seek (fd, 0);
+  CHECK (read (fd, buf2, sizeof buf2) == sizeof buf2,
+         "read \"%s\"", file_name);
+  compare_bytes (buf2, buf1, sizeof buf1, 0, file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
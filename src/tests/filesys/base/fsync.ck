@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fsync) begin
+(fsync) create "syncme"
+(fsync) open "syncme"
+(fsync) write "syncme"
+(fsync) fsync "syncme"
+(fsync) fsync bad fd (must fail)
+(fsync) sync
+(fsync) seek "syncme" to 0
+(fsync) read "syncme"
+(fsync) close "syncme"
+(fsync) end
+EOF
+pass;
@@ -0,0 +1,50 @@
+/* Benchmark, not run by "make check": spawns 8 child processes
+   that read two files over and over, half of them one file and
+   half the other, and make sure that the contents are what they
+   should be.
+
+   Unlike syn-read, whose children read a byte at a time to
+   provoke contention, these children read whole sectors, so
+   that the run time is dominated by the file system itself.
+   Readers of the same or different files need not wait for one
+   another, so comparing the tick count printed at shutdown for
+   this test against a run with fewer children, and the lock
+   statistics printed by a kernel built with LOCKSTAT=1, shows
+   how well reads scale.  A user program cannot observe whether
+   reads overlapped, so this does not fail when they are
+   serialized. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/base/par-read.h"
+
+static char buf[BUF_SIZE];
+
+#define CHILD_CNT 8
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  size_t i;
+
+  random_bytes (buf, sizeof buf);
+  for (i = 0; i < sizeof file_names / sizeof *file_names; i++)
+    {
+      const char *file_name = file_names[i];
+      int fd;
+
+      CHECK (create (file_name, 0), "create \"%s\"", file_name);
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+      CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+             "write \"%s\"", file_name);
+      msg ("close \"%s\"", file_name);
+      close (fd);
+    }
+
+  exec_children ("child-par-read", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+}
@@ -0,0 +1,9 @@
+#ifndef TESTS_FILESYS_BASE_PAR_READ_H
+#define TESTS_FILESYS_BASE_PAR_READ_H
+
+#define BUF_SIZE 8192
+#define CHUNK_SIZE 512
+#define PASS_CNT 50
+static const char *file_names[] = {"data-a", "data-b"};
+
+#endif /* tests/filesys/base/par-read.h */
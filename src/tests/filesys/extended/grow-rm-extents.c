@@ -0,0 +1,88 @@
+/* Run with -extents.  Grows a file to about a third of the file
+   system and removes it, several times over, so that the file
+   system fills up unless removing a file returns all of its
+   extents to the free map.  Then grows two files in parallel,
+   which gives each of them many short extents, and checks that
+   their contents are correct. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK_SIZE 8192
+#define BIG_CHUNKS 80
+#define ROUND_CNT 4
+#define FILE_SIZE 20143
+
+static char chunk[CHUNK_SIZE];
+static char buf_a[FILE_SIZE];
+static char buf_b[FILE_SIZE];
+
+static void
+write_some_bytes (const char *file_name, int fd, const char *buf, size_t *ofs) 
+{
+  if (*ofs < FILE_SIZE) 
+    {
+      size_t block_size = random_ulong () % (FILE_SIZE / 16) + 1;
+      size_t ret_val;
+      if (block_size > FILE_SIZE - *ofs)
+        block_size = FILE_SIZE - *ofs;
+
+      ret_val = write (fd, buf + *ofs, block_size);
+      if (ret_val != block_size)
+        fail ("write %zu bytes at offset %zu in \"%s\" returned %zu",
+              block_size, *ofs, file_name, ret_val);
+      *ofs += block_size;
+    }
+}
+
+void
+test_main (void) 
+{
+  int fd, fd_a, fd_b;
+  size_t ofs_a = 0, ofs_b = 0;
+  int round, i;
+
+  random_init (0);
+  random_bytes (buf_a, sizeof buf_a);
+  random_bytes (buf_b, sizeof buf_b);
+  memset (chunk, 0x5a, sizeof chunk);
+
+  for (round = 0; round < ROUND_CNT; round++) 
+    {
+      CHECK (create ("big", 0), "create \"big\"");
+      CHECK ((fd = open ("big")) > 1, "open \"big\"");
+      msg ("grow \"big\" to %d bytes", CHUNK_SIZE * BIG_CHUNKS);
+      for (i = 0; i < BIG_CHUNKS; i++)
+        if (write (fd, chunk, CHUNK_SIZE) != CHUNK_SIZE)
+          fail ("write %d bytes at offset %d in \"big\" failed",
+                CHUNK_SIZE, i * CHUNK_SIZE);
+      msg ("close \"big\"");
+      close (fd);
+      CHECK (remove ("big"), "remove \"big\"");
+    }
+
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK (create ("b", 0), "create \"b\"");
+
+  CHECK ((fd_a = open ("a")) > 1, "open \"a\"");
+  CHECK ((fd_b = open ("b")) > 1, "open \"b\"");
+
+  msg ("write \"a\" and \"b\" alternately");
+  while (ofs_a < FILE_SIZE || ofs_b < FILE_SIZE) 
+    {
+      write_some_bytes ("a", fd_a, buf_a, &ofs_a);
+      write_some_bytes ("b", fd_b, buf_b, &ofs_b);
+    }
+
+  msg ("close \"a\"");
+  close (fd_a);
+
+  msg ("close \"b\"");
+  close (fd_b);
+
+  check_file ("a", buf_a, FILE_SIZE);
+  check_file ("b", buf_b, FILE_SIZE);
+}
@@ -0,0 +1,43 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-rm-extents) begin
+(grow-rm-extents) create "big"
+(grow-rm-extents) open "big"
+(grow-rm-extents) grow "big" to 655360 bytes
+(grow-rm-extents) close "big"
+(grow-rm-extents) remove "big"
+(grow-rm-extents) create "big"
+(grow-rm-extents) open "big"
+(grow-rm-extents) grow "big" to 655360 bytes
+(grow-rm-extents) close "big"
+(grow-rm-extents) remove "big"
+(grow-rm-extents) create "big"
+(grow-rm-extents) open "big"
+(grow-rm-extents) grow "big" to 655360 bytes
+(grow-rm-extents) close "big"
+(grow-rm-extents) remove "big"
+(grow-rm-extents) create "big"
+(grow-rm-extents) open "big"
+(grow-rm-extents) grow "big" to 655360 bytes
+(grow-rm-extents) close "big"
+(grow-rm-extents) remove "big"
+(grow-rm-extents) create "a"
+(grow-rm-extents) create "b"
+(grow-rm-extents) open "a"
+(grow-rm-extents) open "b"
+(grow-rm-extents) write "a" and "b" alternately
+(grow-rm-extents) close "a"
+(grow-rm-extents) close "b"
+(grow-rm-extents) open "a" for verification
+(grow-rm-extents) verified contents of "a"
+(grow-rm-extents) close "a"
+(grow-rm-extents) open "b" for verification
+(grow-rm-extents) verified contents of "b"
+(grow-rm-extents) close "b"
+(grow-rm-extents) end
+EOF
+pass;
@@ -0,0 +1,155 @@
+/* Test program for lib/kernel/bitmap.c.
+
+   Checks bitmap_scan(), bitmap_count(), bitmap_contains() and
+   bitmap_set_multiple() against simple bit-at-a-time versions
+   of the same operations, then times both on a large, mostly
+   full bitmap of the kind the page allocator, the free map and
+   the swap table search.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/test.h"
+
+/* Number of bits in the bitmaps we test. */
+#define BIT_CNT 8192
+
+/* Number of searches to time. */
+#define SEARCH_CNT 200
+
+static size_t slow_scan (const struct bitmap *, size_t start, size_t cnt,
+                         bool value);
+static size_t slow_count (const struct bitmap *, size_t start, size_t cnt,
+                          bool value);
+static void verify (void);
+static void benchmark (void);
+
+/* Test the bitmap implementation. */
+void
+test (void)
+{
+  verify ();
+  benchmark ();
+}
+
+/* Checks the word-at-a-time operations against the slow ones on
+   randomly filled bitmaps. */
+static void
+verify (void)
+{
+  static uint8_t buf[BIT_CNT / 8 + 64];
+  int round;
+
+  printf ("verifying:");
+  for (round = 0; round < 64; round++)
+    {
+      size_t bit_cnt = random_ulong () % BIT_CNT;
+      struct bitmap *b = bitmap_create_in_buf (bit_cnt, buf, sizeof buf);
+      int op;
+
+      printf (" %d", round);
+      for (op = 0; op < 256; op++)
+        {
+          size_t start = random_ulong () % (bit_cnt + 1);
+          size_t cnt = random_ulong () % (bit_cnt - start + 1);
+          bool value = random_ulong () % 2;
+          size_t want;
+
+          bitmap_set_multiple (b, start, cnt, value);
+          ASSERT (slow_count (b, start, cnt, value) == cnt);
+
+          start = random_ulong () % (bit_cnt + 1);
+          cnt = random_ulong () % (bit_cnt - start + 1);
+          ASSERT (bitmap_count (b, start, cnt, value)
+                  == slow_count (b, start, cnt, value));
+          ASSERT (bitmap_contains (b, start, cnt, value)
+                  == (slow_count (b, start, cnt, value) > 0));
+
+          cnt = 1 + random_ulong () % 32;
+          want = slow_scan (b, start, cnt, value);
+          ASSERT (bitmap_scan (b, start, cnt, value) == want);
+          ASSERT (bitmap_scan_and_flip (b, start, cnt, value) == want);
+          if (want != BITMAP_ERROR)
+            {
+              ASSERT (slow_count (b, want, cnt, !value) == cnt);
+            }
+        }
+    }
+  printf (" done\n");
+}
+
+/* Times searches for free runs of various lengths in a bitmap
+   whose first three quarters are full, apart from scattered
+   single free bits, which is where first-fit allocators spend
+   their time. */
+static void
+benchmark (void)
+{
+  static uint8_t buf[BIT_CNT / 8 + 64];
+  static const size_t run_lengths[] = {1, 4, 16, 64};
+  struct bitmap *b = bitmap_create_in_buf (BIT_CNT, buf, sizeof buf);
+  size_t i;
+
+  bitmap_set_multiple (b, 0, BIT_CNT * 3 / 4, true);
+  for (i = 0; i < BIT_CNT * 3 / 4; i += 37)
+    bitmap_reset (b, i);
+
+  for (i = 0; i < sizeof run_lengths / sizeof *run_lengths; i++)
+    {
+      size_t cnt = run_lengths[i];
+      int64_t start;
+      int64_t slow_ticks, fast_ticks;
+      int j;
+
+      start = timer_ticks ();
+      for (j = 0; j < SEARCH_CNT; j++)
+        slow_scan (b, 0, cnt, false);
+      slow_ticks = timer_elapsed (start);
+
+      start = timer_ticks ();
+      for (j = 0; j < SEARCH_CNT; j++)
+        bitmap_scan (b, 0, cnt, false);
+      fast_ticks = timer_elapsed (start);
+
+      printf ("scan for %zu free bits: bit at a time %"PRId64" ticks, "
+              "word at a time %"PRId64" ticks\n",
+              cnt, slow_ticks, fast_ticks);
+    }
+}
+
+/* Returns the first index at or after START that begins a run of
+   CNT bits set to VALUE, testing one bit at a time. */
+static size_t
+slow_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i;
+
+  if (cnt > bitmap_size (b))
+    return BITMAP_ERROR;
+  for (i = start; i + cnt <= bitmap_size (b); i++)
+    if (slow_count (b, i, cnt, value) == cnt)
+      return i;
+  return BITMAP_ERROR;
+}
+
+/* Returns the number of bits from START to START + CNT that are
+   set to VALUE, testing one bit at a time. */
+static size_t
+slow_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i, value_cnt = 0;
+
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test (b, start + i) == value)
+      value_cnt++;
+  return value_cnt;
+}
@@ -0,0 +1,213 @@
+/* Test program for the block functions in lib/string.c.
+
+   Checks memcpy(), memmove(), memset(), memcmp(), memchr() and
+   strlen() against byte-at-a-time versions of the same
+   functions for many sizes and alignments, then times both
+   versions on page-sized buffers, the size the kernel most
+   often copies and clears.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/test.h"
+
+/* Size of the test buffers. */
+#define BUF_SIZE 4096
+
+/* Number of times to repeat each timed operation. */
+#define REPEAT_CNT 2000
+
+static unsigned char buf_a[BUF_SIZE + 64];
+static unsigned char buf_b[BUF_SIZE + 64];
+static unsigned char buf_c[BUF_SIZE + 64];
+
+static void verify (void);
+static void benchmark (void);
+
+/* Byte-at-a-time reference versions.  NO_INLINE keeps the
+   compiler from folding them into the callers being timed. */
+static void *slow_memcpy (void *, const void *, size_t) NO_INLINE;
+static void *slow_memset (void *, int, size_t) NO_INLINE;
+static int slow_memcmp (const void *, const void *, size_t) NO_INLINE;
+static size_t slow_strlen (const char *) NO_INLINE;
+
+/* Test the string functions. */
+void
+test (void)
+{
+  verify ();
+  benchmark ();
+}
+
+/* Compares the word-at-a-time functions with the slow ones at
+   every combination of small offsets and a range of sizes. */
+static void
+verify (void)
+{
+  size_t src_ofs, dst_ofs, size;
+
+  printf ("verifying:");
+  for (src_ofs = 0; src_ofs < 8; src_ofs++)
+    {
+      printf (" %zu", src_ofs);
+      for (dst_ofs = 0; dst_ofs < 8; dst_ofs++)
+        for (size = 0; size < 80; size++)
+          {
+            int value = random_ulong ();
+            unsigned char ch;
+            size_t i;
+
+            /* memcpy(). */
+            random_bytes (buf_a, sizeof buf_a);
+            memcpy (buf_b, buf_a, sizeof buf_b);
+            memcpy (buf_a + dst_ofs, buf_c + src_ofs, size);
+            slow_memcpy (buf_b + dst_ofs, buf_c + src_ofs, size);
+            ASSERT (!slow_memcmp (buf_a, buf_b, sizeof buf_a));
+
+            /* memmove(), in both directions. */
+            memmove (buf_a + dst_ofs, buf_a + src_ofs, size);
+            for (i = 0; i < size; i++)
+              buf_c[i] = buf_b[src_ofs + i];
+            slow_memcpy (buf_b + dst_ofs, buf_c, size);
+            ASSERT (!slow_memcmp (buf_a, buf_b, sizeof buf_a));
+
+            /* memset(). */
+            memset (buf_a + dst_ofs, value, size);
+            slow_memset (buf_b + dst_ofs, value, size);
+            ASSERT (!slow_memcmp (buf_a, buf_b, sizeof buf_a));
+
+            /* memcmp(), with and without a difference. */
+            ASSERT (memcmp (buf_a + src_ofs, buf_b + src_ofs, size) == 0);
+            if (size > 0)
+              {
+                buf_b[src_ofs + random_ulong () % size] ^= 0x40;
+                ASSERT (memcmp (buf_a + src_ofs, buf_b + src_ofs, size)
+                        == slow_memcmp (buf_a + src_ofs, buf_b + src_ofs,
+                                        size));
+              }
+
+            /* memchr(). */
+            ch = buf_a[src_ofs + random_ulong () % (size + 1)];
+            for (i = 0; i < size; i++)
+              if (buf_a[src_ofs + i] == ch)
+                break;
+            ASSERT (memchr (buf_a + src_ofs, ch, size)
+                    == (i < size ? buf_a + src_ofs + i : NULL));
+
+            /* strlen(). */
+            for (i = 0; i < size; i++)
+              buf_a[src_ofs + i] |= 1;
+            buf_a[src_ofs + size] = '\0';
+            ASSERT (strlen ((char *) buf_a + src_ofs) == size);
+          }
+    }
+  printf (" done\n");
+}
+
+/* Times each function against its slow version. */
+static void
+benchmark (void)
+{
+  int64_t start, slow, fast;
+  int i;
+
+  random_bytes (buf_a, sizeof buf_a);
+
+  start = timer_ticks ();
+  for (i = 0; i < REPEAT_CNT; i++)
+    slow_memcpy (buf_b, buf_a, BUF_SIZE);
+  slow = timer_elapsed (start);
+  start = timer_ticks ();
+  for (i = 0; i < REPEAT_CNT; i++)
+    memcpy (buf_b, buf_a, BUF_SIZE);
+  fast = timer_elapsed (start);
+  printf ("memcpy: %"PRId64" ticks before, %"PRId64" ticks after\n",
+          slow, fast);
+
+  start = timer_ticks ();
+  for (i = 0; i < REPEAT_CNT; i++)
+    slow_memset (buf_b, 0, BUF_SIZE);
+  slow = timer_elapsed (start);
+  start = timer_ticks ();
+  for (i = 0; i < REPEAT_CNT; i++)
+    memset (buf_b, 0, BUF_SIZE);
+  fast = timer_elapsed (start);
+  printf ("memset: %"PRId64" ticks before, %"PRId64" ticks after\n",
+          slow, fast);
+
+  memcpy (buf_b, buf_a, BUF_SIZE);
+  start = timer_ticks ();
+  for (i = 0; i < REPEAT_CNT; i++)
+    slow_memcmp (buf_b, buf_a, BUF_SIZE);
+  slow = timer_elapsed (start);
+  start = timer_ticks ();
+  for (i = 0; i < REPEAT_CNT; i++)
+    memcmp (buf_b, buf_a, BUF_SIZE);
+  fast = timer_elapsed (start);
+  printf ("memcmp: %"PRId64" ticks before, %"PRId64" ticks after\n",
+          slow, fast);
+
+  memset (buf_a, 'x', BUF_SIZE);
+  buf_a[BUF_SIZE - 1] = '\0';
+  start = timer_ticks ();
+  for (i = 0; i < REPEAT_CNT; i++)
+    slow_strlen ((char *) buf_a);
+  slow = timer_elapsed (start);
+  start = timer_ticks ();
+  for (i = 0; i < REPEAT_CNT; i++)
+    strlen ((char *) buf_a);
+  fast = timer_elapsed (start);
+  printf ("strlen: %"PRId64" ticks before, %"PRId64" ticks after\n",
+          slow, fast);
+}
+
+static void *
+slow_memcpy (void *dst_, const void *src_, size_t size)
+{
+  unsigned char *dst = dst_;
+  const unsigned char *src = src_;
+
+  while (size-- > 0)
+    *dst++ = *src++;
+  return dst_;
+}
+
+static void *
+slow_memset (void *dst_, int value, size_t size)
+{
+  unsigned char *dst = dst_;
+
+  while (size-- > 0)
+    *dst++ = value;
+  return dst_;
+}
+
+static int
+slow_memcmp (const void *a_, const void *b_, size_t size)
+{
+  const unsigned char *a = a_;
+  const unsigned char *b = b_;
+
+  for (; size-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? +1 : -1;
+  return 0;
+}
+
+static size_t
+slow_strlen (const char *string)
+{
+  const char *p;
+
+  for (p = string; *p != '\0'; p++)
+    continue;
+  return p - string;
+}
@@ -0,0 +1,46 @@
+/* Checks that epoch_synchronize() waits for readers that were
+   already inside a read-side critical section, but not for
+   readers that entered after it started. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static thread_func synchronize_thread;
+static struct epoch epoch;
+static struct semaphore done;
+
+void
+test_epoch_synchronize (void) 
+{
+  unsigned old_idx, new_idx;
+
+  epoch_init (&epoch);
+  sema_init (&done, 0);
+
+  old_idx = epoch_enter (&epoch);
+  thread_create ("synchronize", PRI_DEFAULT, synchronize_thread, NULL);
+  timer_sleep (10);
+
+  /* A reader that arrives now must not hold up the synchronizer,
+     or the sema_down() below would never return. */
+  new_idx = epoch_enter (&epoch);
+  msg ("Reader entered the new epoch.");
+
+  msg ("Old reader leaving.");
+  epoch_exit (&epoch, old_idx);
+  sema_down (&done);
+  epoch_exit (&epoch, new_idx);
+}
+
+static void
+synchronize_thread (void *aux UNUSED) 
+{
+  msg ("Synchronizer waiting for readers.");
+  epoch_synchronize (&epoch);
+  msg ("Synchronize returned.");
+  sema_up (&done);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(epoch-synchronize) begin
+(epoch-synchronize) Synchronizer waiting for readers.
+(epoch-synchronize) Reader entered the new epoch.
+(epoch-synchronize) Old reader leaving.
+(epoch-synchronize) Synchronize returned.
+(epoch-synchronize) end
+EOF
+pass;
@@ -0,0 +1,52 @@
+/* Checks that several threads can hold a readers-writer lock for
+   reading at the same time.  The main thread holds a read lock
+   while it waits for three other readers to acquire theirs; if
+   readers excluded each other, the test would deadlock. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define READER_CNT 3
+
+static thread_func reader_thread;
+static struct rwlock rwlock;
+static struct semaphore acquired;
+
+void
+test_rwlock_readers (void) 
+{
+  int i;
+
+  rwlock_init (&rwlock);
+  sema_init (&acquired, 0);
+
+  rwlock_acquire_read (&rwlock);
+  for (i = 0; i < READER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT, reader_thread, NULL);
+    }
+
+  for (i = 0; i < READER_CNT; i++)
+    sema_down (&acquired);
+  msg ("All %d readers held the lock alongside the main thread.",
+       READER_CNT);
+  rwlock_release_read (&rwlock);
+
+  if (!rwlock_try_acquire_write (&rwlock))
+    fail ("lock still held after all readers released it");
+  rwlock_release_write (&rwlock);
+  pass ();
+}
+
+static void
+reader_thread (void *aux UNUSED) 
+{
+  rwlock_acquire_read (&rwlock);
+  sema_up (&acquired);
+  rwlock_release_read (&rwlock);
+}
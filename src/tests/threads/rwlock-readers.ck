@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-readers) begin
+(rwlock-readers) All 3 readers held the lock alongside the main thread.
+(rwlock-readers) PASS
+(rwlock-readers) end
+EOF
+pass;
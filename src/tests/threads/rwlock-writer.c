@@ -0,0 +1,61 @@
+/* Checks writer preference and fairness of readers-writer locks.
+   While the main thread holds a read lock, a writer queues up.
+   From then on new readers must wait too, so the writer cannot
+   starve.  When the writer is done, the reader that queued up
+   behind it gets the lock. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static thread_func writer_thread;
+static thread_func reader_thread;
+static struct rwlock rwlock;
+static struct semaphore done;
+
+void
+test_rwlock_writer (void) 
+{
+  rwlock_init (&rwlock);
+  sema_init (&done, 0);
+
+  rwlock_acquire_read (&rwlock);
+  thread_create ("writer", PRI_DEFAULT, writer_thread, NULL);
+  timer_sleep (10);
+
+  if (rwlock_try_acquire_read (&rwlock))
+    fail ("new reader got in ahead of a waiting writer");
+  msg ("New readers are held off by the waiting writer.");
+
+  thread_create ("reader", PRI_DEFAULT, reader_thread, NULL);
+  timer_sleep (10);
+
+  msg ("Main thread releasing read lock.");
+  rwlock_release_read (&rwlock);
+
+  sema_down (&done);
+  sema_down (&done);
+}
+
+static void
+writer_thread (void *aux UNUSED) 
+{
+  msg ("Writer waiting.");
+  rwlock_acquire_write (&rwlock);
+  msg ("Writer acquired lock.");
+  rwlock_release_write (&rwlock);
+  sema_up (&done);
+}
+
+static void
+reader_thread (void *aux UNUSED) 
+{
+  msg ("Reader waiting.");
+  rwlock_acquire_read (&rwlock);
+  msg ("Reader acquired lock.");
+  rwlock_release_read (&rwlock);
+  sema_up (&done);
+}
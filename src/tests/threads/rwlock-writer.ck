@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer) begin
+(rwlock-writer) Writer waiting.
+(rwlock-writer) New readers are held off by the waiting writer.
+(rwlock-writer) Reader waiting.
+(rwlock-writer) Main thread releasing read lock.
+(rwlock-writer) Writer acquired lock.
+(rwlock-writer) Reader acquired lock.
+(rwlock-writer) end
+EOF
+pass;
@@ -0,0 +1,68 @@
+/* Checks the object cache allocator.  Objects come back from
+   slab_alloc() constructed, the constructor runs only once per
+   object even when objects are freed and reallocated, and the
+   most recently freed object is the next one handed out. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/slab.h"
+
+#define OBJ_CNT 100
+
+struct obj
+  {
+    int magic;
+    char payload[37];
+  };
+
+static int ctor_cnt;
+
+static void
+obj_ctor (void *obj_) 
+{
+  struct obj *obj = obj_;
+  obj->magic = 0x1234;
+  ctor_cnt++;
+}
+
+void
+test_slab_lifo (void) 
+{
+  static struct slab_cache cache;
+  struct obj *objs[OBJ_CNT];
+  struct obj *again;
+  int ctors_before;
+  int i;
+
+  slab_cache_init (&cache, "slab-lifo", sizeof (struct obj), obj_ctor);
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objs[i] = slab_alloc (&cache);
+      if (objs[i] == NULL)
+        fail ("allocation %d failed", i);
+      if (objs[i]->magic != 0x1234)
+        fail ("object %d not constructed", i);
+    }
+  msg ("Allocated %d objects.", OBJ_CNT);
+
+  ctors_before = ctor_cnt;
+  slab_free (&cache, objs[OBJ_CNT / 2]);
+  again = slab_alloc (&cache);
+  if (again != objs[OBJ_CNT / 2])
+    fail ("most recently freed object was not reused");
+  if (again->magic != 0x1234)
+    fail ("reused object lost its constructed state");
+  if (ctor_cnt != ctors_before)
+    fail ("constructor ran again for a reused object");
+  msg ("Freed object was reused without reconstruction.");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    slab_free (&cache, objs[i]);
+  if (cache.active_cnt != 0)
+    fail ("%zu objects still in use after freeing all", cache.active_cnt);
+  if (cache.slab_cnt > 1)
+    fail ("%zu empty slabs retained", cache.slab_cnt);
+  msg ("All objects freed.");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-lifo) begin
+(slab-lifo) Allocated 100 objects.
+(slab-lifo) Freed object was reused without reconstruction.
+(slab-lifo) All objects freed.
+(slab-lifo) end
+EOF
+pass;
@@ -29,6 +29,12 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"rwlock-readers", test_rwlock_readers},
+    {"rwlock-writer", test_rwlock_writer},
+    {"epoch-synchronize", test_epoch_synchronize},
+    {"workqueue-order", test_workqueue_order},
+    {"workqueue-delayed", test_workqueue_delayed},
+    {"slab-lifo", test_slab_lifo},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -23,6 +23,12 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_rwlock_readers;
+extern test_func test_rwlock_writer;
+extern test_func test_epoch_synchronize;
+extern test_func test_workqueue_order;
+extern test_func test_workqueue_delayed;
+extern test_func test_slab_lifo;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -0,0 +1,58 @@
+/* Checks delayed work.  Three items are delayed by different
+   amounts, out of order; they must run in order of expiry.  A
+   fourth is cancelled before its timer expires and must not
+   run at all. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+struct item
+  {
+    struct work work;
+    int id;
+  };
+
+static work_func item_func;
+
+void
+test_workqueue_delayed (void) 
+{
+  static const int delays[] = {30, 10, 20, 15};
+  struct item items[4];
+  struct workqueue *wq;
+  int i;
+
+  wq = workqueue_create ("delayed", PRI_DEFAULT, 1);
+  ASSERT (wq != NULL);
+
+  for (i = 0; i < 4; i++)
+    {
+      items[i].id = i;
+      work_init (&items[i].work, item_func);
+      workqueue_queue_delayed (wq, &items[i].work, delays[i]);
+    }
+
+  if (!work_cancel (&items[3].work))
+    fail ("delayed work item 3 was not pending");
+  msg ("Cancelled work item 3.");
+
+  timer_sleep (50);
+  workqueue_flush (wq);
+  msg ("Flush complete.");
+
+  if (work_cancel (&items[0].work))
+    fail ("work item 0 still pending after it ran");
+
+  workqueue_destroy (wq);
+}
+
+static void
+item_func (struct work *w) 
+{
+  struct item *item = work_entry (w, struct item, work);
+  msg ("Work item %d ran.", item->id);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue-delayed) begin
+(workqueue-delayed) Cancelled work item 3.
+(workqueue-delayed) Work item 1 ran.
+(workqueue-delayed) Work item 2 ran.
+(workqueue-delayed) Work item 0 ran.
+(workqueue-delayed) Flush complete.
+(workqueue-delayed) end
+EOF
+pass;
@@ -0,0 +1,54 @@
+/* Queues work items on a single-worker work queue and checks
+   that they run in the order they were queued, only after the
+   queuing thread lets the worker run, and that
+   workqueue_flush() waits for all of them. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+
+#define WORK_CNT 5
+
+struct item
+  {
+    struct work work;
+    int id;
+  };
+
+static work_func item_func;
+
+void
+test_workqueue_order (void) 
+{
+  struct item items[WORK_CNT];
+  struct workqueue *wq;
+  int i;
+
+  wq = workqueue_create ("order", PRI_DEFAULT, 1);
+  ASSERT (wq != NULL);
+
+  for (i = 0; i < WORK_CNT; i++)
+    {
+      items[i].id = i;
+      work_init (&items[i].work, item_func);
+      if (!workqueue_queue (wq, &items[i].work))
+        fail ("work item %d could not be queued", i);
+    }
+  if (workqueue_queue (wq, &items[0].work))
+    fail ("work item 0 queued twice");
+  msg ("Queued %d work items.", WORK_CNT);
+
+  workqueue_flush (wq);
+  msg ("Flush complete.");
+
+  workqueue_destroy (wq);
+}
+
+static void
+item_func (struct work *w) 
+{
+  struct item *item = work_entry (w, struct item, work);
+  msg ("Work item %d ran.", item->id);
+}
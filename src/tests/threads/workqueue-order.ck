@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue-order) begin
+(workqueue-order) Queued 5 work items.
+(workqueue-order) Work item 0 ran.
+(workqueue-order) Work item 1 ran.
+(workqueue-order) Work item 2 ran.
+(workqueue-order) Work item 3 ran.
+(workqueue-order) Work item 4 ran.
+(workqueue-order) Flush complete.
+(workqueue-order) end
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Child process run by exec-parallel test.
+   Given an argument, executes and waits for itself without one
+   EXEC_CNT times, then returns the argument.  Without an
+   argument, just terminates. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-exec-par";
+
+#define EXEC_CNT 10
+
+int
+main (int argc, char *argv[]) 
+{
+  int i;
+
+  quiet = true;
+  if (argc < 2)
+    return 0;
+
+  for (i = 0; i < EXEC_CNT; i++)
+    {
+      pid_t pid;
+      CHECK ((pid = exec ("child-exec-par")) != -1, "exec \"child-exec-par\"");
+      CHECK (wait (pid) == 0, "wait for \"child-exec-par\"");
+    }
+  return atoi (argv[1]);
+}
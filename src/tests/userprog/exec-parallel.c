@@ -0,0 +1,23 @@
+/* Spawns 6 child processes, each of which executes and waits for
+   a trivial program 10 times, so that several processes are
+   loading executables at once.
+
+   Loading a program reads its executable through the file
+   system, which other processes may be using at the same time,
+   so the tick count printed at shutdown for this test, compared
+   with a run of exec-multiple, shows how well exec scales. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 6
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+
+  exec_children ("child-exec-par", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+}
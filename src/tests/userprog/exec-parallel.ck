@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(exec-parallel) begin
+(exec-parallel) exec child 1 of 6: "child-exec-par 0"
+(exec-parallel) exec child 2 of 6: "child-exec-par 1"
+(exec-parallel) exec child 3 of 6: "child-exec-par 2"
+(exec-parallel) exec child 4 of 6: "child-exec-par 3"
+(exec-parallel) exec child 5 of 6: "child-exec-par 4"
+(exec-parallel) exec child 6 of 6: "child-exec-par 5"
+(exec-parallel) wait for child 1 of 6 returned 0 (expected 0)
+(exec-parallel) wait for child 2 of 6 returned 1 (expected 1)
+(exec-parallel) wait for child 3 of 6 returned 2 (expected 2)
+(exec-parallel) wait for child 4 of 6 returned 3 (expected 3)
+(exec-parallel) wait for child 5 of 6 returned 4 (expected 4)
+(exec-parallel) wait for child 6 of 6 returned 5 (expected 5)
+(exec-parallel) end
+EOF
+pass;
@@ -1,6 +1,7 @@
 #include "threads/init.h"
 #include "vm/frametable.h"
 #include "vm/swaptable.h"
+#include "vm/spagetable.h"
 #include <console.h>
 #include <debug.h>
 #include <inttypes.h>
@@ -22,8 +23,10 @@
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -36,8 +39,11 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/ramdisk.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/inode.h"
 #endif
 
 /* Page directory with kernel mappings only. */
@@ -121,9 +127,11 @@ main (void)
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+  workqueue_init ();
 
 #ifdef FILESYS
   /* Initialize file system. */
+  ramdisk_init ();
   ide_init ();
   locate_block_devices ();
   filesys_init (format_filesys);
@@ -132,6 +140,7 @@ main (void)
   /* Initialize virtual memory items */
   init_frametable(init_ram_pages);
   swaptable_init();
+  spagetable_init ();
 
   printf ("Boot complete.\n");
   
@@ -253,6 +262,14 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-cache"))
+        cache_sector_cnt = atoi (value);
+      else if (!strcmp (name, "-flush"))
+        cache_flush_age = atoi (value);
+      else if (!strcmp (name, "-extents"))
+        inode_use_extents = true;
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_configure (value);
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -298,6 +315,17 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+/* Prints how much memory the page allocator, malloc(), and the
+   object caches are using.  Putting this action after "run"
+   shows what a task left allocated. */
+static void
+run_mstat (char **argv UNUSED)
+{
+  palloc_print_stats ();
+  malloc_print_stats ();
+  slab_print_stats ();
+}
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -315,6 +343,7 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"mstat", 1, run_mstat},
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
@@ -363,6 +392,7 @@ usage (void)
 #else
           "  run TEST           Run TEST.\n"
 #endif
+          "  mstat              Print memory allocator statistics.\n"
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
@@ -379,6 +409,10 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -cache=SECTORS     Cache SECTORS file system sectors (default 64).\n"
+          "  -flush=TICKS       Write back data dirty for TICKS timer ticks.\n"
+          "  -extents           Create files with extent-based inodes.\n"
+          "  -ramdisk=ROLE,KB   Add a KB kB RAM disk for ROLE, swap or scratch.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
@@ -5,8 +5,10 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
@@ -32,15 +34,51 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   To keep threads from contending for the descriptor locks, each
+   thread also has a "magazine" of free blocks for each
+   descriptor, kept in its struct thread.  malloc() and free()
+   normally just take a block from or put a block into the
+   running thread's magazine, which no other thread touches, so
+   no lock is needed.  Only when the magazine is empty (or full)
+   do we lock the descriptor and move half a magazine's worth of
+   blocks at once.  A thread's magazines are emptied when it
+   exits.
+
+   Similarly, a few recently freed big blocks are kept around,
+   instead of going straight back to the page allocator, to be
+   reused by requests for the same number of pages.
+
+   We count the blocks and bytes handed out to callers, per
+   descriptor and in total, and malloc_print_stats() reports
+   them along with how full each descriptor's arenas are.  When
+   the kernel is built with MALLOC_TAGS defined, each block also
+   records the address malloc() was called from, so that memory
+   that is never freed can be traced back to its allocation
+   site. */
+
+/* Allocation counts, for malloc_print_stats(). */
+struct mem_usage
+  {
+    unsigned long long alloc_cnt;       /* Successful allocations. */
+    size_t live_cnt;                    /* Blocks allocated now. */
+    size_t peak_cnt;                    /* Maximum of LIVE_CNT. */
+    size_t live_bytes;                  /* Bytes allocated now. */
+    size_t peak_bytes;                  /* Maximum of LIVE_BYTES. */
+  };
 
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    size_t block_ofs;           /* Offset of first block in an arena. */
     struct list free_list;      /* List of free blocks. */
+    struct list arenas;         /* All arenas. */
     struct lock lock;           /* Lock. */
+    char name[16];              /* Name, for lock statistics. */
+    struct mem_usage usage;     /* Blocks held by callers. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -52,6 +90,10 @@ struct arena
     unsigned magic;             /* Always set to ARENA_MAGIC. */
     struct desc *desc;          /* Owning descriptor, null for big block. */
     size_t free_cnt;            /* Free blocks; pages in big block. */
+    struct list_elem elem;      /* In desc's arenas, or big block list. */
+#ifdef MALLOC_TAGS
+    void *tag;                  /* Allocation site of big block. */
+#endif
   };
 
 /* Free block. */
@@ -64,8 +106,56 @@ struct block
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Number of blocks moved between a magazine and its descriptor
+   at once. */
+#define MAGAZINE_BATCH (MAGAZINE_SIZE / 2)
+
+/* Recently freed big blocks, kept for reuse. */
+#define BIG_CACHE_MAX 4         /* Maximum number of cached blocks. */
+#define BIG_CACHE_MAX_PAGES 8   /* Largest block worth caching. */
+static struct list big_cache;   /* Cached big blocks, most recent first. */
+static size_t big_cache_cnt;    /* Number of cached big blocks. */
+#ifdef MALLOC_TAGS
+static struct list big_live;    /* Big blocks held by callers. */
+#endif
+static struct lock big_lock;    /* Protects the lists above. */
+
+/* Usage of big blocks, and of all blocks together.  These and
+   each descriptor's usage are updated with interrupts off, so
+   that blocks taken from and put into magazines can be counted
+   without taking a lock. */
+static struct mem_usage big_usage;
+static struct mem_usage total_usage;
+
+/* Records the caller of malloc(), calloc(), or realloc() in the
+   blocks they return, if tags are enabled. */
+#ifdef MALLOC_TAGS
+#define CALLER __builtin_return_address (0)
+#else
+#define CALLER NULL
+#endif
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void refill_magazine (struct desc *, struct magazine *);
+static void drain_magazine (struct desc *, struct magazine *, size_t cnt);
+static void release_block (struct desc *, struct block *);
+static struct arena *get_big_block (size_t page_cnt);
+static void put_big_block (struct arena *);
+static void *allocate (size_t size, void *tag);
+static void count_alloc (struct mem_usage *, size_t bytes);
+static void count_free (struct mem_usage *, size_t bytes);
+static void set_tag (struct arena *, struct block *, void *tag);
+#ifdef MALLOC_TAGS
+static void print_sites (void);
+#endif
+
+/* Returns the running thread's magazine for descriptor D. */
+static inline struct magazine *
+get_magazine (struct desc *d) 
+{
+  return &thread_current ()->magazines[d - descs];
+}
 
 /* Initializes the malloc() descriptors. */
 void
@@ -78,9 +168,45 @@ malloc_init (void)
       struct desc *d = &descs[desc_cnt++];
       ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
       d->block_size = block_size;
+#ifdef MALLOC_TAGS
+      /* Each block's tag goes in an array between the arena
+         header and the blocks. */
+      d->blocks_per_arena = ((PGSIZE - sizeof (struct arena))
+                             / (block_size + sizeof (void *)));
+      d->block_ofs = (sizeof (struct arena)
+                      + d->blocks_per_arena * sizeof (void *));
+#else
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+      d->block_ofs = sizeof (struct arena);
+#endif
       list_init (&d->free_list);
+      list_init (&d->arenas);
       lock_init (&d->lock);
+      snprintf (d->name, sizeof d->name, "malloc %zu", block_size);
+      lock_set_name (&d->lock, d->name);
+    }
+  ASSERT (desc_cnt <= MAGAZINE_CLASSES);
+
+  list_init (&big_cache);
+#ifdef MALLOC_TAGS
+  list_init (&big_live);
+#endif
+  lock_init (&big_lock);
+  lock_set_name (&big_lock, "malloc big");
+}
+
+/* Returns the blocks in the running thread's magazines to their
+   descriptors.  Called by thread_exit(). */
+void
+malloc_thread_exit (void) 
+{
+  struct desc *d;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    {
+      struct magazine *m = get_magazine (d);
+      if (m->cnt > 0)
+        drain_magazine (d, m, m->cnt);
     }
 }
 
@@ -88,10 +214,19 @@ malloc_init (void)
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) 
+{
+  return allocate (size, CALLER);
+}
+
+/* Does the work of malloc(), recording TAG as the allocation
+   site of the new block. */
+static void *
+allocate (size_t size, void *tag) 
 {
   struct desc *d;
-  struct block *b;
+  struct magazine *m;
   struct arena *a;
+  struct block *b;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -107,7 +242,9 @@ malloc (size_t size)
       /* SIZE is too big for any descriptor.
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-      a = palloc_get_multiple (0, page_cnt);
+      a = get_big_block (page_cnt);
+      if (a == NULL)
+        a = palloc_get_multiple (0, page_cnt);
       if (a == NULL)
         return NULL;
 
@@ -116,40 +253,23 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+      set_tag (a, NULL, tag);
+      count_alloc (&big_usage, page_cnt * PGSIZE);
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
+  /* Take the most recently freed block from our magazine,
+     refilling it first if it is empty. */
+  m = get_magazine (d);
+  if (m->cnt == 0)
     {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
-
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
-        }
+      refill_magazine (d, m);
+      if (m->cnt == 0)
+        return NULL;
     }
-
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
-  lock_release (&d->lock);
+  b = m->blocks[--m->cnt];
+  set_tag (block_to_arena (b), b, tag);
+  count_alloc (&d->usage, d->block_size);
   return b;
 }
 
@@ -167,7 +287,7 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = allocate (size, CALLER);
   if (p != NULL)
     memset (p, 0, size);
 
@@ -201,7 +321,7 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block = allocate (new_size, CALLER);
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -232,32 +352,23 @@ free (void *p)
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
+          set_tag (a, b, NULL);
+          count_free (&d->usage, d->block_size);
   
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
-            {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
-            }
-
-          lock_release (&d->lock);
+          /* Put it in our magazine, first making room by giving
+             the oldest blocks in it back to the descriptor. */
+          struct magazine *m = get_magazine (d);
+          if (m->cnt >= MAGAZINE_SIZE)
+            drain_magazine (d, m, MAGAZINE_BATCH);
+          m->blocks[m->cnt++] = b;
         }
       else
         {
-          /* It's a big block.  Free its pages. */
-          palloc_free_multiple (a, a->free_cnt);
+          /* It's a big block.  Keep it for reuse, or free its
+             pages. */
+          set_tag (a, NULL, NULL);
+          count_free (&big_usage, a->free_cnt * PGSIZE);
+          put_big_block (a);
           return;
         }
     }
@@ -275,7 +386,8 @@ block_to_arena (struct block *b)
 
   /* Check that the block is properly aligned for the arena. */
   ASSERT (a->desc == NULL
-          || (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+          || (pg_ofs (b) >= a->desc->block_ofs
+              && (pg_ofs (b) - a->desc->block_ofs) % a->desc->block_size == 0));
   ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
   return a;
@@ -289,6 +401,385 @@ arena_to_block (struct arena *a, size_t idx)
   ASSERT (a->magic == ARENA_MAGIC);
   ASSERT (idx < a->desc->blocks_per_arena);
   return (struct block *) ((uint8_t *) a
-                           + sizeof *a
+                           + a->desc->block_ofs
                            + idx * a->desc->block_size);
 }
+
+/* Moves up to MAGAZINE_BATCH blocks from D's free list into M,
+   which must be empty, creating a new arena if the free list is
+   empty.  Leaves M empty if no memory is available. */
+static void
+refill_magazine (struct desc *d, struct magazine *m) 
+{
+  ASSERT (m->cnt == 0);
+
+  lock_acquire (&d->lock);
+  while (m->cnt < MAGAZINE_BATCH)
+    {
+      struct block *b;
+      struct arena *a;
+
+      /* If the free list is empty, create a new arena. */
+      if (list_empty (&d->free_list))
+        {
+          size_t i;
+
+          /* Allocate a page.  If we already have a block, make do
+             with that. */
+          a = palloc_get_page (0);
+          if (a == NULL) 
+            break;
+
+          /* Initialize arena and add its blocks to the free list. */
+          a->magic = ARENA_MAGIC;
+          a->desc = d;
+          a->free_cnt = d->blocks_per_arena;
+          list_push_back (&d->arenas, &a->elem);
+#ifdef MALLOC_TAGS
+          memset (a + 1, 0, d->blocks_per_arena * sizeof (void *));
+#endif
+          for (i = 0; i < d->blocks_per_arena; i++) 
+            {
+              struct block *b = arena_to_block (a, i);
+              list_push_back (&d->free_list, &b->free_elem);
+            }
+        }
+
+      /* Get a block from free list.  The magazine hands out its
+         last block first, so fill it back to front. */
+      b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+      a = block_to_arena (b);
+      a->free_cnt--;
+      m->blocks[m->cnt++] = b;
+    }
+  lock_release (&d->lock);
+
+  /* Put the first block taken from the free list on top. */
+  if (m->cnt > 1)
+    {
+      void *first = m->blocks[0];
+      m->blocks[0] = m->blocks[m->cnt - 1];
+      m->blocks[m->cnt - 1] = first;
+    }
+}
+
+/* Returns the CNT oldest blocks in M to D's free list. */
+static void
+drain_magazine (struct desc *d, struct magazine *m, size_t cnt) 
+{
+  size_t i;
+
+  ASSERT (cnt <= m->cnt);
+
+  lock_acquire (&d->lock);
+  for (i = 0; i < cnt; i++)
+    release_block (d, m->blocks[i]);
+  lock_release (&d->lock);
+
+  for (i = cnt; i < m->cnt; i++)
+    m->blocks[i - cnt] = m->blocks[i];
+  m->cnt -= cnt;
+}
+
+/* Adds block B to D's free list, freeing its arena if it is now
+   entirely unused.  D's lock must be held. */
+static void
+release_block (struct desc *d, struct block *b) 
+{
+  struct arena *a = block_to_arena (b);
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+  ASSERT (a->desc == d);
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_remove (&b->free_elem);
+        }
+      list_remove (&a->elem);
+      palloc_free_page (a);
+    }
+}
+
+/* Removes from the cache, and returns, a big block of exactly
+   PAGE_CNT pages, or returns a null pointer if there is none. */
+static struct arena *
+get_big_block (size_t page_cnt) 
+{
+  struct list_elem *e;
+  struct arena *found = NULL;
+
+  if (page_cnt > BIG_CACHE_MAX_PAGES)
+    return NULL;
+
+  lock_acquire (&big_lock);
+  for (e = list_begin (&big_cache); e != list_end (&big_cache);
+       e = list_next (e))
+    {
+      struct arena *a = list_entry (e, struct arena, elem);
+      if (a->free_cnt == page_cnt)
+        {
+          list_remove (e);
+          big_cache_cnt--;
+          found = a;
+          break;
+        }
+    }
+  lock_release (&big_lock);
+
+  return found;
+}
+
+/* Caches big block A for reuse, freeing the least recently
+   cached block if the cache is full.  Blocks too big to be worth
+   caching are freed at once. */
+static void
+put_big_block (struct arena *a) 
+{
+  struct arena *victim = NULL;
+
+  if (a->free_cnt > BIG_CACHE_MAX_PAGES)
+    {
+      palloc_free_multiple (a, a->free_cnt);
+      return;
+    }
+
+  lock_acquire (&big_lock);
+  list_push_front (&big_cache, &a->elem);
+  if (++big_cache_cnt > BIG_CACHE_MAX)
+    {
+      victim = list_entry (list_pop_back (&big_cache), struct arena, elem);
+      big_cache_cnt--;
+    }
+  lock_release (&big_lock);
+
+  if (victim != NULL)
+    palloc_free_multiple (victim, victim->free_cnt);
+}
+
+/* Adds an allocation of BYTES bytes to U. */
+static void
+add_usage (struct mem_usage *u, size_t bytes) 
+{
+  u->alloc_cnt++;
+  if (++u->live_cnt > u->peak_cnt)
+    u->peak_cnt = u->live_cnt;
+  u->live_bytes += bytes;
+  if (u->live_bytes > u->peak_bytes)
+    u->peak_bytes = u->live_bytes;
+}
+
+/* Counts an allocation of BYTES bytes against U and the total. */
+static void
+count_alloc (struct mem_usage *u, size_t bytes) 
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  add_usage (u, bytes);
+  add_usage (&total_usage, bytes);
+  intr_set_level (old_level);
+}
+
+/* Counts the freeing of BYTES bytes against U and the total. */
+static void
+count_free (struct mem_usage *u, size_t bytes) 
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  u->live_cnt--;
+  u->live_bytes -= bytes;
+  total_usage.live_cnt--;
+  total_usage.live_bytes -= bytes;
+  intr_set_level (old_level);
+}
+
+/* Records TAG as the allocation site of block B in arena A, or
+   of big block A if B is null.  A null TAG marks the block
+   free.  Does nothing unless tags are enabled. */
+static void
+set_tag (struct arena *a UNUSED, struct block *b UNUSED, void *tag UNUSED) 
+{
+#ifdef MALLOC_TAGS
+  if (b != NULL)
+    {
+      struct desc *d = a->desc;
+      void **tags = (void **) (a + 1);
+      tags[(pg_ofs (b) - d->block_ofs) / d->block_size] = tag;
+    }
+  else
+    {
+      /* Big blocks held by callers are kept on a list, so that
+         print_sites() can find them. */
+      lock_acquire (&big_lock);
+      if (tag != NULL)
+        list_push_front (&big_live, &a->elem);
+      else
+        list_remove (&a->elem);
+      a->tag = tag;
+      lock_release (&big_lock);
+    }
+#endif
+}
+
+/* Prints U, which describes blocks called NAME. */
+static void
+print_usage (const char *name, const struct mem_usage *u) 
+{
+  printf ("%s: %zu blocks in use (peak %zu), %zu bytes (peak %zu), "
+          "%llu allocations\n",
+          name, u->live_cnt, u->peak_cnt, u->live_bytes, u->peak_bytes,
+          u->alloc_cnt);
+}
+
+/* Prints statistics for each of malloc()'s size classes, and for
+   big blocks.  Blocks in threads' magazines are free from the
+   callers' point of view but in use from their arenas'. */
+void
+malloc_print_stats (void) 
+{
+  struct desc *d;
+
+  print_usage ("malloc", &total_usage);
+  for (d = descs; d < descs + desc_cnt; d++)
+    {
+      size_t arena_cnt = 0;
+      size_t hist[4] = {0, 0, 0, 0};
+      struct list_elem *e;
+
+      /* Sort the arenas by the fraction of their blocks in use,
+         in quarters. */
+      lock_acquire (&d->lock);
+      for (e = list_begin (&d->arenas); e != list_end (&d->arenas);
+           e = list_next (e))
+        {
+          struct arena *a = list_entry (e, struct arena, elem);
+          size_t used = d->blocks_per_arena - a->free_cnt;
+
+          hist[used > 0 ? (used * 4 - 1) / d->blocks_per_arena : 0]++;
+          arena_cnt++;
+        }
+      lock_release (&d->lock);
+
+      print_usage (d->name, &d->usage);
+      printf ("  %zu arenas, %zu%% of arena space in use; "
+              "arenas by blocks in use: %zu <=25%%, %zu <=50%%, "
+              "%zu <=75%%, %zu <=100%%\n",
+              arena_cnt,
+              (arena_cnt > 0
+               ? d->usage.live_bytes * 100 / (arena_cnt * PGSIZE) : 0),
+              hist[0], hist[1], hist[2], hist[3]);
+    }
+  print_usage ("malloc big", &big_usage);
+  printf ("  %zu cached\n", big_cache_cnt);
+
+#ifdef MALLOC_TAGS
+  print_sites ();
+#endif
+}
+
+#ifdef MALLOC_TAGS
+/* Number of distinct allocation sites print_sites() tracks. */
+#define SITE_CNT 32
+
+/* Blocks allocated from one place. */
+struct site
+  {
+    void *tag;                  /* Return address in caller. */
+    size_t cnt;                 /* Blocks in use. */
+    size_t bytes;               /* Bytes in those blocks. */
+  };
+
+/* Adds a block of BYTES bytes allocated at TAG to the CNT sites
+   in SITES, unless they are full.  Returns the new number of
+   sites. */
+static size_t
+add_site (struct site sites[], size_t cnt, void *tag, size_t bytes) 
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (sites[i].tag == tag)
+      break;
+  if (i == cnt)
+    {
+      if (cnt >= SITE_CNT)
+        return cnt;
+      sites[cnt].tag = tag;
+      sites[cnt].cnt = sites[cnt].bytes = 0;
+      cnt++;
+    }
+  sites[i].cnt++;
+  sites[i].bytes += bytes;
+  return cnt;
+}
+
+/* Prints the places that the blocks now in use were allocated
+   from, most bytes first.  Use the "backtrace" utility to turn
+   the addresses into function names. */
+static void
+print_sites (void) 
+{
+  struct site sites[SITE_CNT];
+  size_t site_cnt = 0;
+  struct desc *d;
+  struct list_elem *e;
+  size_t i, j;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    {
+      lock_acquire (&d->lock);
+      for (e = list_begin (&d->arenas); e != list_end (&d->arenas);
+           e = list_next (e))
+        {
+          struct arena *a = list_entry (e, struct arena, elem);
+          void **tags = (void **) (a + 1);
+
+          for (i = 0; i < d->blocks_per_arena; i++)
+            if (tags[i] != NULL)
+              site_cnt = add_site (sites, site_cnt, tags[i], d->block_size);
+        }
+      lock_release (&d->lock);
+    }
+
+  lock_acquire (&big_lock);
+  for (e = list_begin (&big_live); e != list_end (&big_live);
+       e = list_next (e))
+    {
+      struct arena *a = list_entry (e, struct arena, elem);
+      site_cnt = add_site (sites, site_cnt, a->tag, a->free_cnt * PGSIZE);
+    }
+  lock_release (&big_lock);
+
+  /* Selection sort, by bytes, descending. */
+  for (i = 0; i < site_cnt; i++)
+    {
+      size_t max = i;
+      struct site tmp;
+
+      for (j = i + 1; j < site_cnt; j++)
+        if (sites[j].bytes > sites[max].bytes)
+          max = j;
+      tmp = sites[i];
+      sites[i] = sites[max];
+      sites[max] = tmp;
+    }
+
+  printf ("malloc blocks in use by allocation site:\n");
+  for (i = 0; i < site_cnt; i++)
+    printf ("  %p: %zu blocks, %zu bytes\n",
+            sites[i].tag, sites[i].cnt, sites[i].bytes);
+  if (site_cnt >= SITE_CNT)
+    printf ("  (at most %d sites are shown)\n", SITE_CNT);
+}
+#endif /* MALLOC_TAGS */
@@ -4,10 +4,27 @@
 #include <debug.h>
 #include <stddef.h>
 
+/* Number of blocks a magazine holds. */
+#define MAGAZINE_SIZE 6
+
+/* Number of size classes with magazines: 16, 32, ..., 1024 bytes. */
+#define MAGAZINE_CLASSES 7
+
+/* A thread's cache of free blocks of one size class, so that
+   most malloc() and free() calls need not take the size class's
+   lock.  Owned by malloc.c. */
+struct magazine
+  {
+    unsigned cnt;                       /* Number of blocks. */
+    void *blocks[MAGAZINE_SIZE];        /* Blocks, most recent last. */
+  };
+
 void malloc_init (void);
+void malloc_thread_exit (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+void malloc_print_stats (void);
 
 #endif /* threads/malloc.h */
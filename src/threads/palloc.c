@@ -7,41 +7,119 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/workqueue.h"
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
    hands out smaller chunks.
 
-   System memory is divided into two "pools" called the kernel
-   and user pools.  The user pool is for user (virtual) memory
-   pages, the kernel pool for everything else.  The idea here is
-   that the kernel needs to have memory for its own operations
-   even if user processes are swapping like mad.
+   All free memory is in a single pool, shared by kernel data
+   and user (virtual) memory pages, so that neither sits on
+   memory the other needs.  The kernel still needs to have memory
+   for its own operations even if user processes are swapping
+   like mad, so the pool has three "watermarks":
 
-   By default, half of system RAM is given to the kernel pool and
-   half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+     - User pages may not take the last MIN_WATER free pages,
+       which are reserved for the kernel.  When a user page
+       cannot be had, the frame table evicts one of its own.
+
+     - When an allocation leaves fewer than LOW_WATER pages
+       free, the reclaim function registered with
+       palloc_set_reclaim() is run on the system work queue to
+       evict user pages until HIGH_WATER pages are free.
+
+     - When a kernel allocation made with PAL_RECLAIM fails
+       outright, the reclaim function is called directly, and
+       the allocation retried, for as long as user pages can be
+       evicted.  Other kernel allocations fail right away, since
+       their callers may hold locks that eviction needs, or be in
+       no position to wait for swap I/O.
+
+   The -ul option still caps the number of user pages.
+
+   Each pool is managed as a binary buddy system.  Free pages
+   are grouped into blocks of 2**ORDER pages, aligned on a
+   2**ORDER page boundary relative to the start of the pool, and
+   each order has its own free list.  An allocation takes a
+   block from the smallest order that is big enough, splitting
+   it in halves as needed; freeing a block merges it with its
+   "buddy", the other half of the block it was split from,
+   whenever that buddy is free too.  A request for a number of
+   pages that is not a power of 2 takes the next larger block
+   and returns the unused tail right away, so callers may free
+   any number of pages they allocated, just as before.
+
+   The free list links live in the first page of each free
+   block, so the only per-page bookkeeping is the bitmap of
+   pages in use.  A page's bit is clear exactly when the page
+   is part of a block on a free list.
+
+   The pool is protected by turning off interrupts, not by a
+   lock, because thread_schedule_tail() frees a dying thread's
+   page in the middle of a thread switch, where it may neither
+   sleep nor find the lock held by the thread being switched
+   to.  Every critical section is short: at most a few dozen
+   list operations. */
+
+/* Number of block orders.  The largest block is
+   2**(ORDER_CNT - 1) pages, that is, 256 MB. */
+#define ORDER_CNT 17
+
+/* Header in the first page of a free block. */
+struct free_block
+  {
+    struct list_elem elem;              /* Element in free list. */
+    unsigned order;                     /* Block is 2**ORDER pages. */
+  };
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    const char *name;                   /* Name, for statistics. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks of each order. */
+    struct bitmap *user_map;            /* Bitmap of user pages. */
+    size_t free_cnt;                    /* Number of free pages. */
+    size_t peak_used;                   /* Most pages ever in use. */
+    size_t user_cnt;                    /* Number of user pages. */
+    size_t user_limit;                  /* Maximum USER_CNT. */
+    size_t peak_user;                   /* Maximum of USER_CNT. */
+    size_t min_water;                   /* Pages reserved for kernel. */
+    size_t low_water;                   /* Start reclaim below this. */
+    size_t high_water;                  /* Reclaim up to this. */
+
+    /* Statistics. */
+    unsigned long long alloc_cnt;       /* Successful allocations. */
+    unsigned long long fail_cnt;        /* Failed allocations. */
+    unsigned long long frag_fail_cnt;   /* Failures with enough free pages,
+                                           but none contiguous. */
+    unsigned long long user_deny_cnt;   /* User allocations refused. */
+    unsigned long long reclaim_cnt;     /* Pages freed by reclaiming. */
   };
 
-/* Two pools: one for kernel data, one for user pages. */
-static struct pool kernel_pool, user_pool;
+/* The pool of all free pages. */
+static struct pool page_pool;
+
+/* Function that evicts user pages, and work item that calls it
+   in the background. */
+static palloc_reclaim_func *reclaim_func;
+static struct work reclaim_work;
 
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
+static void *get_pages (struct pool *, bool user, size_t page_cnt);
+static void reclaim_worker (struct work *);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t alloc_block (struct pool *, unsigned order);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static unsigned size_to_order (size_t page_cnt);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
-   pages are put into the user pool. */
+   pages may be in use as user pages at once. */
 void
 palloc_init (size_t user_page_limit)
 {
@@ -49,42 +127,56 @@ palloc_init (size_t user_page_limit)
   uint8_t *free_start = ptov (1024 * 1024);
   uint8_t *free_end = ptov (init_ram_pages * PGSIZE);
   size_t free_pages = (free_end - free_start) / PGSIZE;
-  size_t user_pages = free_pages / 2;
-  size_t kernel_pages;
-  if (user_pages > user_page_limit)
-    user_pages = user_page_limit;
-  kernel_pages = free_pages - user_pages;
+  struct pool *pool = &page_pool;
 
-  /* Give half of memory to kernel, half to user. */
-  init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
-  init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
-             user_pages, "user pool");
+  init_pool (pool, free_start, free_pages, "page pool");
+
+  /* Keep 1/64 of memory, but at least 4 pages, for the kernel,
+     and try to keep twice to three times that much free. */
+  pool->min_water = pool->free_cnt / 64;
+  if (pool->min_water < 4)
+    pool->min_water = 4;
+  pool->low_water = pool->min_water * 2;
+  pool->high_water = pool->min_water * 3;
+  pool->user_limit = user_page_limit;
+
+  work_init (&reclaim_work, reclaim_worker);
+}
+
+/* Registers RECLAIM as the function that the page allocator
+   calls to evict user pages when memory runs low.  RECLAIM is
+   passed the number of pages wanted and returns the number of
+   pages it freed. */
+void
+palloc_set_reclaim (palloc_reclaim_func *reclaim)
+{
+  reclaim_func = reclaim;
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
-   If PAL_USER is set, the pages are obtained from the user pool,
-   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-   then the pages are filled with zeros.  If too few pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   If PAL_USER is set, the pages are user pages, which are
+   counted against the user page limit and may not take the
+   pages reserved for the kernel.  If PAL_RECLAIM is set, user
+   pages are evicted if that is what it takes to satisfy the
+   request, which may block; the caller must not hold any lock
+   that eviction takes.  If PAL_ZERO is set in FLAGS, then the
+   pages are filled with zeros.  If too few pages are available, returns a null
+   pointer, unless PAL_ASSERT is set in FLAGS, in which case the
+   kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
-  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  struct pool *pool = &page_pool;
+  bool user = (flags & PAL_USER) != 0;
   void *pages;
-  size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
-
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+  pages = get_pages (pool, user, page_cnt);
+  while (pages == NULL && (flags & PAL_RECLAIM) && reclaim_func != NULL
+         && reclaim_func (page_cnt) > 0)
+    pages = get_pages (pool, user, page_cnt);
 
   if (pages != NULL) 
     {
@@ -102,8 +194,8 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 
 /* Obtains a single free page and returns its kernel virtual
    address.
-   If PAL_USER is set, the page is obtained from the user pool,
-   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
+   If PAL_USER is set, the page is a user page.  If PAL_ZERO is
+   set in FLAGS,
    then the page is filled with zeros.  If no pages are
    available, returns a null pointer, unless PAL_ASSERT is set in
    FLAGS, in which case the kernel panics. */
@@ -117,18 +209,15 @@ palloc_get_page (enum palloc_flags flags)
 void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
-  struct pool *pool;
+  struct pool *pool = &page_pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
     return;
 
-  if (page_from_pool (&kernel_pool, pages))
-    pool = &kernel_pool;
-  else if (page_from_pool (&user_pool, pages))
-    pool = &user_pool;
-  else
+  if (!page_from_pool (pool, pages))
     NOT_REACHED ();
 
   page_idx = pg_no (pages) - pg_no (pool->base);
@@ -137,8 +226,17 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  if (bitmap_test (pool->user_map, page_idx))
+    {
+      ASSERT (bitmap_all (pool->user_map, page_idx, page_cnt));
+      bitmap_set_multiple (pool->user_map, page_idx, page_cnt, false);
+      pool->user_cnt -= page_cnt;
+    }
+  free_range (pool, page_idx, page_cnt);
+  pool->free_cnt += page_cnt;
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -153,10 +251,13 @@ palloc_free_page (void *page)
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  unsigned order;
+
+  /* We'll put the pool's used_map and user_map at its base.
+     Calculate the space needed for the bitmaps
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size * 2, PGSIZE);
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -164,9 +265,111 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->user_map = bitmap_create_in_buf (page_cnt, (uint8_t *) base + bm_size,
+                                      bm_size);
   p->base = base + bm_pages * PGSIZE;
+  p->name = name;
+  for (order = 0; order < ORDER_CNT; order++)
+    list_init (&p->free_lists[order]);
+  p->alloc_cnt = p->fail_cnt = p->frag_fail_cnt = 0;
+  p->peak_used = 0;
+  p->user_cnt = p->user_limit = p->peak_user = 0;
+  p->min_water = p->low_water = p->high_water = 0;
+  p->user_deny_cnt = p->reclaim_cnt = 0;
+
+  /* Put all of the pool's pages on the free lists. */
+  bitmap_set_all (p->used_map, true);
+  free_range (p, 0, page_cnt);
+  p->free_cnt = page_cnt;
+}
+
+/* Takes PAGE_CNT contiguous pages from POOL, as user pages if
+   USER is true, and returns the first one, or a null pointer if
+   they cannot be had.  Starts reclaiming user pages in the
+   background if POOL is running low or a kernel allocation
+   fails. */
+static void *
+get_pages (struct pool *pool, bool user, size_t page_cnt) 
+{
+  size_t page_idx = BITMAP_ERROR;
+  unsigned order = size_to_order (page_cnt);
+  enum intr_level old_level;
+  bool low;
+
+  old_level = intr_disable ();
+  if (user
+      && (pool->user_cnt + page_cnt > pool->user_limit
+          || pool->free_cnt < pool->min_water + page_cnt))
+    pool->user_deny_cnt++;
+  else
+    {
+      if (order < ORDER_CNT)
+        page_idx = alloc_block (pool, order);
+      if (page_idx != BITMAP_ERROR)
+        {
+          /* Give back the part of the block we don't need. */
+          free_range (pool, page_idx + page_cnt,
+                      ((size_t) 1 << order) - page_cnt);
+          pool->free_cnt -= page_cnt;
+          pool->alloc_cnt++;
+          if (bitmap_size (pool->used_map) - pool->free_cnt > pool->peak_used)
+            pool->peak_used = bitmap_size (pool->used_map) - pool->free_cnt;
+          if (user)
+            {
+              bitmap_set_multiple (pool->user_map, page_idx, page_cnt, true);
+              pool->user_cnt += page_cnt;
+              if (pool->user_cnt > pool->peak_user)
+                pool->peak_user = pool->user_cnt;
+            }
+        }
+      else
+        {
+          pool->fail_cnt++;
+          if (pool->free_cnt >= page_cnt)
+            pool->frag_fail_cnt++;
+        }
+    }
+  low = ((pool->free_cnt < pool->low_water
+          || (!user && page_idx == BITMAP_ERROR))
+         && pool->user_cnt > 0);
+  intr_set_level (old_level);
+
+  /* Kernel allocations that fail without PAL_RECLAIM count on
+     the background reclaim, too.  The system work queue does not
+     exist early in boot, when there are no user pages anyway. */
+  if (low && reclaim_func != NULL && system_wq != NULL)
+    workqueue_queue (system_wq, &reclaim_work);
+
+  return page_idx != BITMAP_ERROR ? pool->base + PGSIZE * page_idx : NULL;
+}
+
+/* Evicts user pages until the pool is back up to its high
+   watermark, or there is nothing left to evict. */
+static void
+reclaim_worker (struct work *w UNUSED) 
+{
+  struct pool *pool = &page_pool;
+
+  for (;;)
+    {
+      enum intr_level old_level;
+      size_t want, got;
+
+      old_level = intr_disable ();
+      want = (pool->free_cnt < pool->high_water
+              ? pool->high_water - pool->free_cnt : 0);
+      intr_set_level (old_level);
+      if (want == 0)
+        break;
+
+      got = reclaim_func (want);
+      old_level = intr_disable ();
+      pool->reclaim_cnt += got;
+      intr_set_level (old_level);
+      if (got == 0)
+        break;
+    }
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +383,171 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the address of page PAGE_IDX in POOL. */
+static inline struct free_block *
+idx_to_block (const struct pool *pool, size_t page_idx)
+{
+  return (struct free_block *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Returns the smallest order of block that holds PAGE_CNT
+   pages. */
+static unsigned
+size_to_order (size_t page_cnt)
+{
+  unsigned order = 0;
+
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
+/* Removes a block of 2**ORDER pages from POOL's free lists,
+   splitting a larger block if necessary, and returns the index
+   of its first page, or BITMAP_ERROR if there is no free block
+   that large.  Interrupts must be off. */
+static size_t
+alloc_block (struct pool *pool, unsigned order)
+{
+  struct free_block *b;
+  size_t page_idx;
+  unsigned o;
+
+  /* Find the smallest nonempty order that is large enough. */
+  for (o = order; o < ORDER_CNT; o++)
+    if (!list_empty (&pool->free_lists[o]))
+      break;
+  if (o >= ORDER_CNT)
+    return BITMAP_ERROR;
+
+  b = list_entry (list_pop_front (&pool->free_lists[o]),
+                  struct free_block, elem);
+  page_idx = pg_no (b) - pg_no (pool->base);
+
+  /* Split it down to size, freeing the upper halves. */
+  while (o > order)
+    {
+      struct free_block *upper;
+
+      o--;
+      upper = idx_to_block (pool, page_idx + ((size_t) 1 << o));
+      upper->order = o;
+      list_push_front (&pool->free_lists[o], &upper->elem);
+    }
+  bitmap_set_multiple (pool->used_map, page_idx, (size_t) 1 << order, true);
+  return page_idx;
+}
+
+/* Adds the 2**ORDER pages starting at PAGE_IDX, which must be
+   marked in use, to POOL's free lists, merging the block with
+   its buddy for as long as the buddy is also free.  Interrupts
+   must be off. */
+static void
+release_block (struct pool *pool, size_t page_idx, unsigned order)
+{
+  size_t pool_pages = bitmap_size (pool->used_map);
+  struct free_block *b;
+
+  bitmap_set_multiple (pool->used_map, page_idx, (size_t) 1 << order, false);
+
+  for (; order + 1 < ORDER_CNT; order++)
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+      struct free_block *buddy;
+
+      /* The buddy is free, and starts a free block, if its first
+         page is unused: a free block that began earlier would
+         also have to cover PAGE_IDX.  It may still have been
+         split into smaller blocks, though. */
+      if (buddy_idx + ((size_t) 1 << order) > pool_pages
+          || bitmap_test (pool->used_map, buddy_idx))
+        break;
+      buddy = idx_to_block (pool, buddy_idx);
+      if (buddy->order != order)
+        break;
+
+      list_remove (&buddy->elem);
+      if (buddy_idx < page_idx)
+        page_idx = buddy_idx;
+    }
+
+  b = idx_to_block (pool, page_idx);
+  b->order = order;
+  list_push_front (&pool->free_lists[order], &b->elem);
+}
+
+/* Adds the PAGE_CNT pages starting at PAGE_IDX, which must be
+   marked in use, to POOL's free lists, breaking the range into
+   the largest aligned blocks that fit.  Interrupts must be off,
+   unless POOL is still being initialized. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      unsigned order = 0;
+
+      while (order + 1 < ORDER_CNT
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+
+      release_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Prints statistics for POOL.  The counters are copied with
+   interrupts off and printed afterward. */
+static void
+print_pool_stats (struct pool *pool_)
+{
+  struct pool pool;
+  size_t block_cnt[ORDER_CNT];
+  size_t largest = 0;
+  enum intr_level old_level;
+  unsigned order;
+
+  old_level = intr_disable ();
+  pool = *pool_;
+  for (order = 0; order < ORDER_CNT; order++)
+    block_cnt[order] = list_size (&pool_->free_lists[order]);
+  intr_set_level (old_level);
+
+  printf ("%s: %zu of %zu pages free (peak %zu in use), "
+          "%llu allocations, %llu failed (%llu due to fragmentation)\n",
+          pool.name, pool.free_cnt, bitmap_size (pool.used_map),
+          pool.peak_used, pool.alloc_cnt, pool.fail_cnt,
+          pool.frag_fail_cnt);
+  printf ("  free blocks by order:");
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      if (block_cnt[order] > 0)
+        largest = (size_t) 1 << order;
+      printf (" %zu", block_cnt[order]);
+    }
+  printf ("\n");
+
+  /* External fragmentation: the share of free memory that cannot
+     be handed out as part of the largest free block. */
+  if (pool.free_cnt > 0)
+    printf ("  largest free block %zu pages, fragmentation %zu%%\n",
+            largest, 100 - largest * 100 / pool.free_cnt);
+
+  printf ("  %zu user pages (peak %zu", pool.user_cnt, pool.peak_user);
+  if (pool.user_limit != SIZE_MAX)
+    printf (", limit %zu", pool.user_limit);
+  printf ("), %llu user allocations refused, %llu pages reclaimed\n",
+          pool.user_deny_cnt, pool.reclaim_cnt);
+  printf ("  watermarks: min %zu, low %zu, high %zu pages\n",
+          pool.min_water, pool.low_water, pool.high_water);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void)
+{
+  print_pool_stats (&page_pool);
+}
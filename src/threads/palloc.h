@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -8,13 +9,20 @@ enum palloc_flags
   {
     PAL_ASSERT = 001,           /* Panic on failure. */
     PAL_ZERO = 002,             /* Zero page contents. */
-    PAL_USER = 004              /* User page. */
+    PAL_USER = 004,             /* User page. */
+    PAL_RECLAIM = 010           /* May block to evict user pages. */
   };
 
+/* Evicts up to PAGE_CNT user pages, blocking as needed, and
+   returns the number of pages freed. */
+typedef size_t palloc_reclaim_func (size_t page_cnt);
+
 void palloc_init (size_t user_page_limit);
+void palloc_set_reclaim (palloc_reclaim_func *);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
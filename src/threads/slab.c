@@ -0,0 +1,260 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Slab header, at the start of each slab's page.
+   The objects follow it. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct slab_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's slab list. */
+    size_t in_use;              /* Number of allocated objects. */
+    void *free;                 /* First free object, or null. */
+  };
+
+/* Keep at most this many empty slabs per cache, so that a cache
+   that repeatedly allocates and frees a single object does not
+   go back to the page allocator every time. */
+#define MAX_EMPTY_SLABS 1
+
+/* All caches, for slab_print_stats().
+   Accessed with interrupts off, because caches may be
+   initialized before the scheduler starts. */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+static struct slab *new_slab (struct slab_cache *);
+static struct slab *obj_to_slab (void *);
+
+/* Returns a pointer to the free-list link stored in OBJ. */
+static inline void **
+free_link (struct slab_cache *cache, void *obj)
+{
+  return (void **) ((uint8_t *) obj + cache->link_ofs);
+}
+
+/* Initializes CACHE to hand out objects of SIZE bytes.  NAME
+   must remain valid as long as the kernel runs.  If CTOR is
+   nonnull, it is called on each object when the object's slab
+   is created. */
+void
+slab_cache_init (struct slab_cache *cache, const char *name, size_t size,
+                 slab_ctor *ctor)
+{
+  enum intr_level old_level;
+  size_t obj_space;
+
+  ASSERT (cache != NULL);
+  ASSERT (name != NULL);
+  ASSERT (size > 0);
+
+  /* Constructed objects must keep their contents while free, so
+     their free link goes after the object.  Otherwise it
+     overlaps the object's first word. */
+  obj_space = ROUND_UP (size, sizeof (void *));
+  if (ctor != NULL)
+    {
+      cache->link_ofs = obj_space;
+      cache->slot_size = obj_space + sizeof (void *);
+    }
+  else
+    {
+      cache->link_ofs = 0;
+      cache->slot_size = obj_space;
+    }
+
+  cache->name = name;
+  cache->obj_size = size;
+  cache->objs_per_slab = (PGSIZE - sizeof (struct slab)) / cache->slot_size;
+  ASSERT (cache->objs_per_slab > 0);
+  cache->ctor = ctor;
+  list_init (&cache->slabs);
+  cache->empty_cnt = 0;
+  lock_init (&cache->lock);
+  lock_set_name (&cache->lock, name);
+
+  cache->alloc_cnt = cache->fail_cnt = 0;
+  cache->active_cnt = cache->peak_cnt = cache->slab_cnt = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&all_caches, &cache->elem);
+  intr_set_level (old_level);
+}
+
+/* Allocates and returns an object from CACHE, or a null pointer
+   if no memory is available.  If CACHE has a constructor, the
+   object is in its constructed state. */
+void *
+slab_alloc (struct slab_cache *cache)
+{
+  struct slab *s;
+  void *obj;
+
+  ASSERT (cache != NULL);
+
+  lock_acquire (&cache->lock);
+
+  /* Use the first slab with a free object, which is the one
+     an object was most recently freed into, or make a new
+     one. */
+  if (!list_empty (&cache->slabs))
+    s = list_entry (list_front (&cache->slabs), struct slab, elem);
+  else
+    {
+      s = new_slab (cache);
+      if (s == NULL)
+        {
+          cache->fail_cnt++;
+          lock_release (&cache->lock);
+          return NULL;
+        }
+      list_push_front (&cache->slabs, &s->elem);
+      cache->empty_cnt++;
+    }
+
+  /* Take its most recently freed object. */
+  obj = s->free;
+  s->free = *free_link (cache, obj);
+  if (s->in_use++ == 0)
+    cache->empty_cnt--;
+  if (s->free == NULL)
+    list_remove (&s->elem);
+
+  cache->alloc_cnt++;
+  if (++cache->active_cnt > cache->peak_cnt)
+    cache->peak_cnt = cache->active_cnt;
+
+  lock_release (&cache->lock);
+  return obj;
+}
+
+/* Returns OBJ, which must have been allocated from CACHE, to
+   CACHE.  If CACHE has a constructor, OBJ must be in its
+   constructed state.  A null OBJ is ignored. */
+void
+slab_free (struct slab_cache *cache, void *obj)
+{
+  struct slab *s;
+
+  ASSERT (cache != NULL);
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (obj);
+  ASSERT (s->cache == cache);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs.
+     Constructed objects must keep their contents. */
+  if (cache->ctor == NULL)
+    memset (obj, 0xcc, cache->obj_size);
+#endif
+
+  lock_acquire (&cache->lock);
+
+  /* Put OBJ at the head of its slab's free list, and the slab
+     at the head of the cache's list, so that OBJ is the next
+     object handed out. */
+  if (s->free != NULL)
+    list_remove (&s->elem);
+  list_push_front (&cache->slabs, &s->elem);
+  *free_link (cache, obj) = s->free;
+  s->free = obj;
+  cache->active_cnt--;
+
+  /* If the slab is now unused, keep it around for the next
+     allocation, unless we already have enough of those. */
+  if (--s->in_use == 0)
+    {
+      if (cache->empty_cnt < MAX_EMPTY_SLABS)
+        cache->empty_cnt++;
+      else
+        {
+          list_remove (&s->elem);
+          cache->slab_cnt--;
+          s->magic = 0;
+          palloc_free_page (s);
+        }
+    }
+
+  lock_release (&cache->lock);
+}
+
+/* Prints statistics for every object cache. */
+void
+slab_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct slab_cache *c = list_entry (e, struct slab_cache, elem);
+      printf ("Cache %s: %zu-byte objects, %zu in use (peak %zu), "
+              "%zu slabs, %llu allocations, %llu failed\n",
+              c->name, c->obj_size, c->active_cnt, c->peak_cnt,
+              c->slab_cnt, c->alloc_cnt, c->fail_cnt);
+    }
+}
+
+/* Obtains a page for a new slab of CACHE, constructs its
+   objects, and returns it, or returns a null pointer if no
+   page is available.  CACHE's lock must be held. */
+static struct slab *
+new_slab (struct slab_cache *cache)
+{
+  struct slab *s;
+  uint8_t *obj;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = cache;
+  s->in_use = 0;
+  s->free = NULL;
+
+  /* Thread the objects onto the free list back to front, so
+     that they are handed out in address order. */
+  obj = (uint8_t *) (s + 1) + cache->objs_per_slab * cache->slot_size;
+  for (i = 0; i < cache->objs_per_slab; i++)
+    {
+      obj -= cache->slot_size;
+      if (cache->ctor != NULL)
+        cache->ctor (obj);
+      *free_link (cache, obj) = s->free;
+      s->free = obj;
+    }
+
+  cache->slab_cnt++;
+  return s;
+}
+
+/* Returns the slab that OBJ is inside. */
+static struct slab *
+obj_to_slab (void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid and OBJ is properly aligned
+     within it. */
+  ASSERT (s != NULL);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT ((pg_ofs (obj) - sizeof *s) % s->cache->slot_size == 0);
+
+  return s;
+}
@@ -0,0 +1,59 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* Object caches.
+
+   A cache hands out objects of a single, fixed size, packed
+   into pages ("slabs") obtained from the page allocator.
+   Unlike malloc(), which rounds every request up to a power of
+   2, a cache wastes no space inside its slots, so objects that
+   are allocated and freed often should have a cache of their
+   own.
+
+   A cache may have a constructor, which is called once for each
+   object when its slab is created.  Objects must be freed in
+   their constructed state, and come back from slab_alloc() in
+   it, so that initialization that is the same every time, such
+   as setting up locks and lists, need not be repeated on each
+   allocation.
+
+   Within a slab, free objects are kept on a LIFO list, and the
+   slab that most recently had an object freed is the first one
+   allocated from, so that allocation tends to return memory
+   that is still in the CPU cache. */
+
+typedef void slab_ctor (void *);
+
+/* An object cache. */
+struct slab_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Size requested by the user. */
+    size_t slot_size;           /* Bytes per object, with free link. */
+    size_t link_ofs;            /* Offset of free link in a slot. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    slab_ctor *ctor;            /* Constructor, or null. */
+    struct list slabs;          /* Slabs with at least one free object. */
+    size_t empty_cnt;           /* Number of slabs with no objects in use. */
+    struct lock lock;           /* Protects everything above and below. */
+    struct list_elem elem;      /* Element in list of all caches. */
+
+    /* Statistics. */
+    unsigned long long alloc_cnt;   /* Successful allocations. */
+    unsigned long long fail_cnt;    /* Failed allocations. */
+    size_t active_cnt;          /* Objects currently allocated. */
+    size_t peak_cnt;            /* Maximum of ACTIVE_CNT. */
+    size_t slab_cnt;            /* Slabs (pages) currently held. */
+  };
+
+void slab_cache_init (struct slab_cache *, const char *name, size_t size,
+                      slab_ctor *);
+void *slab_alloc (struct slab_cache *) __attribute__ ((malloc));
+void slab_free (struct slab_cache *, void *);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -27,10 +27,23 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#ifdef LOCKSTAT
+#include "devices/timer.h"
+
+/* Semaphores and locks named by sema_set_name(), in the order
+   they were named.  These are the ones lock_print_stats()
+   reports on. */
+static struct list named_locks = LIST_INITIALIZER (named_locks);
+
+static void record_wait (struct lock_stat *, void *pc, int64_t waited);
+#endif
+
+static void sema_down_from (struct semaphore *, void *pc);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -48,6 +61,9 @@ sema_init (struct semaphore *sema, unsigned value)
 
   sema->value = value;
   list_init (&sema->waiters);
+#ifdef LOCKSTAT
+  memset (&sema->stat, 0, sizeof sema->stat);
+#endif
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -59,19 +75,41 @@ sema_init (struct semaphore *sema, unsigned value)
    thread will probably turn interrupts back on. */
 void
 sema_down (struct semaphore *sema) 
+{
+  sema_down_from (sema, __builtin_return_address (0));
+}
+
+/* Does the work of sema_down().  PC is the code address on whose
+   behalf we are waiting, for contention statistics. */
+static void
+sema_down_from (struct semaphore *sema, void *pc UNUSED) 
 {
   enum intr_level old_level;
+#ifdef LOCKSTAT
+  int64_t start = 0;
+  bool contended;
+#endif
 
   ASSERT (sema != NULL);
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
+#ifdef LOCKSTAT
+  contended = sema->value == 0;
+  if (contended)
+    start = timer_ticks ();
+#endif
   while (sema->value == 0) 
     {
       list_push_back (&sema->waiters, &thread_current ()->elem);
       thread_block ();
     }
   sema->value--;
+#ifdef LOCKSTAT
+  sema->stat.acquire_cnt++;
+  if (contended)
+    record_wait (&sema->stat, pc, timer_ticks () - start);
+#endif
   intr_set_level (old_level);
 }
 
@@ -92,6 +130,9 @@ sema_try_down (struct semaphore *sema)
   if (sema->value > 0) 
     {
       sema->value--;
+#ifdef LOCKSTAT
+      sema->stat.acquire_cnt++;
+#endif
       success = true; 
     }
   else
@@ -120,6 +161,28 @@ sema_up (struct semaphore *sema)
   intr_set_level (old_level);
 }
 
+/* Names SEMA for lock_print_stats(), which only reports on
+   named semaphores and locks.  Only objects that are never
+   freed or reinitialized should be named, because they stay on
+   the list of named locks for good.  Does nothing unless the
+   kernel was built with LOCKSTAT. */
+void
+sema_set_name (struct semaphore *sema UNUSED, const char *name UNUSED) 
+{
+#ifdef LOCKSTAT
+  enum intr_level old_level;
+
+  ASSERT (sema != NULL);
+  ASSERT (name != NULL);
+
+  old_level = intr_disable ();
+  if (sema->stat.name == NULL)
+    list_push_back (&named_locks, &sema->stat.elem);
+  sema->stat.name = name;
+  intr_set_level (old_level);
+#endif
+}
+
 static void sema_test_helper (void *sema_);
 
 /* Self-test for semaphores that makes control "ping-pong"
@@ -196,8 +259,11 @@ lock_acquire (struct lock *lock)
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
-  sema_down (&lock->semaphore);
+  sema_down_from (&lock->semaphore, __builtin_return_address (0));
   lock->holder = thread_current ();
+#ifdef LOCKSTAT
+  lock->semaphore.stat.acquired_at = timer_ticks ();
+#endif
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -216,7 +282,12 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock->holder = thread_current ();
+#ifdef LOCKSTAT
+      lock->semaphore.stat.acquired_at = timer_ticks ();
+#endif
+    }
   return success;
 }
 
@@ -231,6 +302,15 @@ lock_release (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+#ifdef LOCKSTAT
+  {
+    struct lock_stat *st = &lock->semaphore.stat;
+    int64_t held = timer_ticks () - st->acquired_at;
+    st->hold_ticks += held;
+    if (held > st->max_hold_ticks)
+      st->max_hold_ticks = held;
+  }
+#endif
   lock->holder = NULL;
   sema_up (&lock->semaphore);
 }
@@ -246,6 +326,89 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+/* Names LOCK for lock_print_stats().  See sema_set_name(). */
+void
+lock_set_name (struct lock *lock, const char *name) 
+{
+  ASSERT (lock != NULL);
+
+  sema_set_name (&lock->semaphore, name);
+}
+
+#ifdef LOCKSTAT
+/* Records in ST that the code at PC had to wait WAITED ticks.
+   Keeps counts for the LOCKSTAT_SITES most frequent waiters,
+   replacing the least frequent one when a new site shows up.
+   Must be called with interrupts off. */
+static void
+record_wait (struct lock_stat *st, void *pc, int64_t waited) 
+{
+  struct lock_site *site, *victim;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  st->contended_cnt++;
+  st->wait_ticks += waited;
+  if (waited > st->max_wait_ticks)
+    st->max_wait_ticks = waited;
+
+  victim = st->sites;
+  for (site = st->sites; site < st->sites + LOCKSTAT_SITES; site++)
+    {
+      if (site->pc == pc)
+        {
+          site->cnt++;
+          return;
+        }
+      if (site->cnt < victim->cnt)
+        victim = site;
+    }
+  victim->pc = pc;
+  victim->cnt = 1;
+}
+
+/* Prints contention statistics for every named semaphore and
+   lock that has been used.  Waiter call sites are printed as
+   addresses; pass them to the `backtrace' utility to get
+   function names. */
+void
+lock_print_stats (void) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&named_locks); e != list_end (&named_locks);
+       e = list_next (e))
+    {
+      struct lock_stat *st = list_entry (e, struct lock_stat, elem);
+      struct lock_site sites[LOCKSTAT_SITES];
+      int i, j;
+
+      if (st->acquire_cnt == 0)
+        continue;
+
+      printf ("Lock %s: %llu acquisitions, %llu contended, "
+              "wait %"PRId64" ticks (max %"PRId64"), "
+              "hold %"PRId64" ticks (max %"PRId64")\n",
+              st->name, st->acquire_cnt, st->contended_cnt,
+              st->wait_ticks, st->max_wait_ticks,
+              st->hold_ticks, st->max_hold_ticks);
+
+      /* Print waiters most frequent first. */
+      memcpy (sites, st->sites, sizeof sites);
+      for (i = 1; i < LOCKSTAT_SITES; i++)
+        for (j = i; j > 0 && sites[j].cnt > sites[j - 1].cnt; j--)
+          {
+            struct lock_site tmp = sites[j];
+            sites[j] = sites[j - 1];
+            sites[j - 1] = tmp;
+          }
+      for (i = 0; i < LOCKSTAT_SITES && sites[i].cnt > 0; i++)
+        printf ("  waiter %p: %u contended acquisitions\n",
+                sites[i].pc, sites[i].cnt);
+    }
+}
+#endif /* LOCKSTAT */
+
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
@@ -336,3 +499,272 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RW as an unheld readers-writer lock.
+
+   A readers-writer lock lets any number of threads hold it for
+   reading at the same time, as long as no thread holds it for
+   writing.  It suits structures that are searched far more often
+   than they are changed, such as the open inode list or a
+   directory.
+
+   Ownership is handed off directly by the releasing thread: a
+   thread that has to wait is woken up only once it already
+   holds the lock, so it never has to recheck a condition. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  rw->readers = 0;
+  rw->writer = NULL;
+  list_init (&rw->read_waiters);
+  list_init (&rw->write_waiters);
+}
+
+/* Acquires RW for reading, sleeping if a writer holds it or is
+   waiting for it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  if (rw->writer == NULL && list_empty (&rw->write_waiters))
+    rw->readers++;
+  else
+    {
+      /* rwlock_release_write() counts us in before waking us. */
+      list_push_back (&rw->read_waiters, &thread_current ()->elem);
+      thread_block ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for reading without sleeping.  Returns
+   true if successful, false if a writer holds or awaits RW. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  success = rw->writer == NULL && list_empty (&rw->write_waiters);
+  if (success)
+    rw->readers++;
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/* Releases a read hold on RW.  If this was the last reader and a
+   writer is waiting, hands RW to that writer. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (rw->readers > 0);
+  if (--rw->readers == 0 && !list_empty (&rw->write_waiters))
+    {
+      rw->writer = list_entry (list_pop_front (&rw->write_waiters),
+                               struct thread, elem);
+      thread_unblock (rw->writer);
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it in either mode.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  if (rw->writer == NULL && rw->readers == 0)
+    rw->writer = thread_current ();
+  else
+    {
+      /* The releasing thread makes us the writer before waking
+         us. */
+      list_push_back (&rw->write_waiters, &thread_current ()->elem);
+      thread_block ();
+    }
+  ASSERT (rw->writer == thread_current ());
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for writing without sleeping.  Returns
+   true if successful, false if RW is held in either mode. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  success = rw->writer == NULL && rw->readers == 0;
+  if (success)
+    rw->writer = thread_current ();
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/* Releases RW, which the current thread must hold for writing.
+   Readers that queued up while we held RW are admitted as a
+   batch ahead of any waiting writer; otherwise RW passes to the
+   longest-waiting writer. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  rw->writer = NULL;
+  while (!list_empty (&rw->read_waiters))
+    {
+      rw->readers++;
+      thread_unblock (list_entry (list_pop_front (&rw->read_waiters),
+                                  struct thread, elem));
+    }
+  if (rw->readers == 0 && !list_empty (&rw->write_waiters))
+    {
+      rw->writer = list_entry (list_pop_front (&rw->write_waiters),
+                               struct thread, elem);
+      thread_unblock (rw->writer);
+    }
+  intr_set_level (old_level);
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise.  Readers are not tracked individually. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
+
+/* Initializes epoch domain E.
+
+   An epoch domain lets lookups run without taking any lock.  A
+   reader calls epoch_enter(), walks the structure, and calls
+   epoch_exit() with the value epoch_enter() returned.  Updaters
+   still serialize among themselves with an ordinary lock.  An
+   updater that removes an object unlinks it, calls
+   epoch_synchronize(), and then frees it: every reader that
+   could have seen the object has finished by then.
+
+   Readers that start after the object was unlinked cannot find
+   it, so epoch_synchronize() only waits for the readers of the
+   epoch that was current when it was called. */
+void
+epoch_init (struct epoch *e)
+{
+  ASSERT (e != NULL);
+
+  e->current = 0;
+  e->readers[0] = e->readers[1] = 0;
+  lock_init (&e->sync_lock);
+  sema_init (&e->drained, 0);
+  e->waiting = false;
+}
+
+/* Enters a read-side critical section of E and returns a token
+   to pass to the matching epoch_exit().  Never sleeps, so it may
+   be called with interrupts disabled. */
+unsigned
+epoch_enter (struct epoch *e)
+{
+  enum intr_level old_level;
+  unsigned idx;
+
+  ASSERT (e != NULL);
+
+  old_level = intr_disable ();
+  idx = e->current;
+  e->readers[idx]++;
+  intr_set_level (old_level);
+
+  return idx;
+}
+
+/* Leaves the read-side critical section of E entered with token
+   IDX, waking up a waiting epoch_synchronize() if this was the
+   last reader of an old epoch. */
+void
+epoch_exit (struct epoch *e, unsigned idx)
+{
+  enum intr_level old_level;
+
+  ASSERT (e != NULL);
+  ASSERT (idx < 2);
+
+  old_level = intr_disable ();
+  ASSERT (e->readers[idx] > 0);
+  if (--e->readers[idx] == 0 && idx != e->current && e->waiting)
+    {
+      e->waiting = false;
+      sema_up (&e->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Waits until every read-side critical section of E that was
+   active when this function was called has ended.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler, nor from within a read-side critical section
+   of E, which would wait for itself forever. */
+void
+epoch_synchronize (struct epoch *e)
+{
+  enum intr_level old_level;
+  unsigned old;
+
+  ASSERT (e != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&e->sync_lock);
+  old_level = intr_disable ();
+  old = e->current;
+  e->current = !old;
+  if (e->readers[old] > 0)
+    {
+      e->waiting = true;
+      intr_set_level (old_level);
+      sema_down (&e->drained);
+    }
+  else
+    intr_set_level (old_level);
+  lock_release (&e->sync_lock);
+}
@@ -3,18 +3,52 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#ifdef LOCKSTAT
+/* Number of distinct waiter call sites remembered per lock. */
+#define LOCKSTAT_SITES 4
+
+/* A code address that had to wait for a lock, and how often. */
+struct lock_site
+  {
+    void *pc;                   /* Caller of sema_down() or lock_acquire(). */
+    unsigned cnt;               /* Number of contended acquisitions. */
+  };
+
+/* Contention statistics kept for each semaphore and lock when
+   the kernel is built with LOCKSTAT defined (see Make.config).
+   Times are in timer ticks. */
+struct lock_stat
+  {
+    const char *name;           /* Set by sema_set_name(), lock_set_name(). */
+    struct list_elem elem;      /* Element in list of named locks. */
+    unsigned long long acquire_cnt;     /* Successful downs/acquires. */
+    unsigned long long contended_cnt;   /* ...that had to wait. */
+    int64_t wait_ticks;         /* Total time spent waiting. */
+    int64_t max_wait_ticks;     /* Longest single wait. */
+    int64_t hold_ticks;         /* Total time held (locks only). */
+    int64_t max_hold_ticks;     /* Longest single hold (locks only). */
+    int64_t acquired_at;        /* When the current holder got it. */
+    struct lock_site sites[LOCKSTAT_SITES]; /* Most frequent waiters. */
+  };
+#endif
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
     struct list waiters;        /* List of waiting threads. */
+#ifdef LOCKSTAT
+    struct lock_stat stat;      /* Contention statistics. */
+#endif
   };
 
 void sema_init (struct semaphore *, unsigned value);
 void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
+void sema_set_name (struct semaphore *, const char *name);
 void sema_self_test (void);
 
 /* Lock. */
@@ -29,6 +63,10 @@ void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+void lock_set_name (struct lock *, const char *name);
+#ifdef LOCKSTAT
+void lock_print_stats (void);
+#endif
 
 /* Condition variable. */
 struct condition 
@@ -41,6 +79,50 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock.
+   Any number of readers may hold the lock at once, or a single
+   writer.  Writers are preferred: once a writer is waiting, new
+   readers queue up behind it.  When a writer releases the lock,
+   every reader that queued up behind it is admitted before the
+   next writer, so neither side can starve the other. */
+struct rwlock
+  {
+    unsigned readers;           /* Number of readers holding the lock. */
+    struct thread *writer;      /* Writer holding the lock, if any. */
+    struct list read_waiters;   /* Threads waiting to read. */
+    struct list write_waiters;  /* Threads waiting to write. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+
+/* Epoch-based read-side protection, in the style of sleepable
+   RCU.  Readers bracket a lookup with epoch_enter() and
+   epoch_exit(), which only bump a counter.  A writer unlinks an
+   object while readers may still see it, calls
+   epoch_synchronize() to wait out every reader that might hold
+   a reference, and only then frees the object.  Readers may
+   sleep inside their critical section. */
+struct epoch
+  {
+    unsigned current;           /* Index of the current epoch, 0 or 1. */
+    unsigned readers[2];        /* Readers active in each epoch. */
+    struct lock sync_lock;      /* Serializes epoch_synchronize(). */
+    struct semaphore drained;   /* Up'd when the old epoch empties. */
+    bool waiting;               /* A synchronizer awaits DRAINED. */
+  };
+
+void epoch_init (struct epoch *);
+unsigned epoch_enter (struct epoch *);
+void epoch_exit (struct epoch *, unsigned idx);
+void epoch_synchronize (struct epoch *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -16,6 +16,9 @@
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
+#ifdef FILESYS
+#include "filesys/directory.h"
+#endif
 
 /* Random value for struct thread's `magic' member.
    Used to detect stack overflow.  See the big comment at the top
@@ -41,6 +44,9 @@ static struct lock tid_lock;
 
 struct lock memory_master_lock;
 
+/* Cache that status holders are allocated from. */
+struct slab_cache status_holder_cache;
+
 void set_denywrite (bool);
 
 /* Stack frame for kernel_thread(). */
@@ -96,7 +102,11 @@ thread_init (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
+  lock_set_name (&tid_lock, "tid_lock");
   lock_init (&memory_master_lock);
+  lock_set_name (&memory_master_lock, "memory_master_lock");
+  slab_cache_init (&status_holder_cache, "status_holder",
+                   sizeof (struct status_holder), NULL);
   list_init (&ready_list);
   list_init (&all_list);
 
@@ -177,6 +187,7 @@ thread_create (const char *name, int priority,
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  struct status_holder *current_statusholder;
   tid_t tid;
   enum intr_level old_level;
 
@@ -186,6 +197,12 @@ thread_create (const char *name, int priority,
   t = palloc_get_page (PAL_ZERO);
   if (t == NULL)
     return TID_ERROR;
+  current_statusholder = slab_alloc (&status_holder_cache);
+  if (current_statusholder == NULL)
+    {
+      palloc_free_page (t);
+      return TID_ERROR;
+    }
 
   /* Initialize thread. */
   init_thread (t, name, priority);
@@ -196,8 +213,6 @@ thread_create (const char *name, int priority,
   t->parent = thread_current();
 
   // create status holder
-  struct status_holder * current_statusholder;
-  current_statusholder = palloc_get_page (0);
   memset (current_statusholder, 0, sizeof (struct status_holder));
   current_statusholder->status = -1;
   current_statusholder->tid = tid;
@@ -213,6 +228,12 @@ thread_create (const char *name, int priority,
 
   t->personal_esp = NULL;
 
+#ifdef FILESYS
+  /* Start out in the creator's working directory. */
+  if (thread_current ()->cwd != NULL)
+    t->cwd = dir_reopen (thread_current ()->cwd);
+#endif
+
   /* Prepare thread for first run by initializing its stack.
      Do this atomically so intermediate values for the 'stack' 
      member cannot be observed. */
@@ -330,21 +351,9 @@ thread_exit (void)
 #endif
 
 
-  struct list_elem * e;
-  for (e = list_begin (&thread_current()->spage_table);
-         e != list_end (&thread_current()->spage_table);)
-    {
-      struct spinfo *spage_info = list_entry (e, struct spinfo, sptable_elem);
-      e = list_next (e);
-
-      if(spage_info->instructions == SWAP) {
-        free_metaswap_entry(spage_info->index_into_swap);
-      }
+  spagetable_destroy (&thread_current ()->spage_table);
 
-      list_remove(&spage_info->sptable_elem);
-      free(spage_info); 
-    }
-    if (lock_held_by_current_thread(&memory_master_lock))
+  if (lock_held_by_current_thread(&memory_master_lock))
   {
     lock_release(&memory_master_lock);
   }
@@ -363,6 +372,10 @@ thread_exit (void)
   thread_current ()->status_number);
   file_close(thread_current ()-> code_file);
   close_files(thread_current ()->open_files);
+#ifdef FILESYS
+  dir_close (thread_current ()->cwd);
+#endif
+  malloc_thread_exit ();
   intr_disable ();
   list_remove (&thread_current ()->allelem);
   thread_current ()->status = THREAD_DYING;
@@ -695,6 +708,6 @@ delete_children(){
         
         list_remove(temp);
         s_holder->owner_thread->stat_holder = NULL;
-        palloc_free_page(s_holder);
+        slab_free (&status_holder_cache, s_holder);
     }
 }
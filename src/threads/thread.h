@@ -5,6 +5,8 @@
 #include <list.h>
 #include <stdint.h>
 #include "synch.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -35,6 +37,9 @@ typedef int tid_t;
     struct thread * owner_thread; // the thread that owns this status holder
   };
 
+/* Cache that status holders are allocated from. */
+extern struct slab_cache status_holder_cache;
+
 
 /* A kernel thread or user process.
 
@@ -126,6 +131,14 @@ struct thread
     uint32_t *pagedir;                  /* Page directory. */
 #endif
 
+#ifdef FILESYS
+    /* Owned by filesys/filesys.c. */
+    struct dir *cwd;                    /* Working directory, or null for root. */
+#endif
+
+    /* Owned by threads/malloc.c. */
+    struct magazine magazines[MAGAZINE_CLASSES]; /* Free block caches. */
+
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
@@ -0,0 +1,391 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* A worker thread. */
+struct worker
+  {
+    struct workqueue *wq;       /* Queue served by this worker. */
+    struct thread *thread;      /* The worker thread itself. */
+    struct work *current;       /* Work item being run, or null. */
+  };
+
+/* A thread in workqueue_flush() or work_flush(). */
+struct flusher
+  {
+    struct list_elem elem;      /* Element in workqueue's flushers. */
+    struct semaphore sema;      /* Up'd whenever a work item finishes. */
+  };
+
+/* Queue shared by code that does not need its own. */
+struct workqueue *system_wq;
+
+/* Delayed work, ordered by wake_tick.
+   Accessed with interrupts off because the timer interrupt
+   handler moves expired entries onto their queues. */
+static struct list delayed_list = LIST_INITIALIZER (delayed_list);
+
+static thread_func worker_thread;
+static bool wake_tick_less (const struct list_elem *,
+                            const struct list_elem *, void *);
+static void make_pending (struct workqueue *, struct work *);
+static bool queue_idle (struct workqueue *, struct work *);
+static bool work_idle (struct workqueue *, struct work *);
+static void wait_until (struct workqueue *, struct work *,
+                        bool (*) (struct workqueue *, struct work *));
+
+/* Creates the system work queue.
+   Must be called after thread_init(). */
+void
+workqueue_init (void)
+{
+  system_wq = workqueue_create ("events", PRI_DEFAULT, 1);
+  if (system_wq == NULL)
+    PANIC ("could not create system work queue");
+}
+
+/* Creates a work queue named NAME served by WORKER_CNT threads
+   of the given PRIORITY.  With more than one worker, work items
+   on the queue may run concurrently with each other.  Returns
+   the new queue, or a null pointer if memory or threads could
+   not be obtained. */
+struct workqueue *
+workqueue_create (const char *name, int priority, int worker_cnt)
+{
+  struct workqueue *wq;
+  int i;
+
+  ASSERT (name != NULL);
+  ASSERT (worker_cnt > 0);
+
+  wq = malloc (sizeof *wq);
+  if (wq == NULL)
+    return NULL;
+  wq->workers = calloc (worker_cnt, sizeof *wq->workers);
+  if (wq->workers == NULL)
+    {
+      free (wq);
+      return NULL;
+    }
+
+  strlcpy (wq->name, name, sizeof wq->name);
+  list_init (&wq->pending);
+  sema_init (&wq->ready, 0);
+  wq->worker_cnt = 0;
+  wq->busy_cnt = 0;
+  wq->dying = false;
+  sema_init (&wq->exited, 0);
+  list_init (&wq->flushers);
+  wq->done_cnt = 0;
+
+  for (i = 0; i < worker_cnt; i++)
+    {
+      struct worker *w = &wq->workers[i];
+      char thread_name[16];
+
+      w->wq = wq;
+      w->thread = NULL;
+      w->current = NULL;
+      snprintf (thread_name, sizeof thread_name, "%s/%d", name, i);
+      if (thread_create (thread_name, priority, worker_thread, w)
+          == TID_ERROR)
+        {
+          workqueue_destroy (wq);
+          return NULL;
+        }
+      wq->worker_cnt++;
+    }
+  return wq;
+}
+
+/* Waits for all the work on WQ to finish, stops its workers,
+   and frees it.  No work may be queued on WQ, or be waiting on
+   a timer to be queued on it, once this function is called. */
+void
+workqueue_destroy (struct workqueue *wq)
+{
+  int i;
+
+  ASSERT (wq != NULL);
+  ASSERT (!intr_context ());
+
+  workqueue_flush (wq);
+  wq->dying = true;
+  for (i = 0; i < wq->worker_cnt; i++)
+    sema_up (&wq->ready);
+  for (i = 0; i < wq->worker_cnt; i++)
+    sema_down (&wq->exited);
+
+  free (wq->workers);
+  free (wq);
+}
+
+/* Initializes W to call FUNC when it runs. */
+void
+work_init (struct work *w, work_func *func)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->wq = NULL;
+  w->state = WORK_IDLE;
+  w->wake_tick = 0;
+}
+
+/* Queues W to run on WQ.  Returns true if successful, false if
+   W was already queued or delayed, in which case it is left
+   alone.  A work item that is running may be queued again,
+   even from its own function.  May be called from an interrupt
+   handler. */
+bool
+workqueue_queue (struct workqueue *wq, struct work *w)
+{
+  enum intr_level old_level;
+  bool queued = false;
+
+  ASSERT (wq != NULL);
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  if (w->state == WORK_IDLE)
+    {
+      make_pending (wq, w);
+      queued = true;
+    }
+  intr_set_level (old_level);
+
+  return queued;
+}
+
+/* Queues W to run on WQ once at least TICKS timer ticks have
+   passed.  Returns true if successful, false if W was already
+   queued or delayed.  May be called from an interrupt
+   handler. */
+bool
+workqueue_queue_delayed (struct workqueue *wq, struct work *w,
+                         int64_t ticks)
+{
+  enum intr_level old_level;
+  bool queued = false;
+
+  ASSERT (wq != NULL);
+  ASSERT (w != NULL);
+
+  if (ticks <= 0)
+    return workqueue_queue (wq, w);
+
+  old_level = intr_disable ();
+  if (w->state == WORK_IDLE)
+    {
+      w->wq = wq;
+      w->state = WORK_DELAYED;
+      w->wake_tick = timer_ticks () + ticks;
+      list_insert_ordered (&delayed_list, &w->elem, wake_tick_less, NULL);
+      queued = true;
+    }
+  intr_set_level (old_level);
+
+  return queued;
+}
+
+/* Moves delayed work whose time has come onto its queue.
+   Called by the timer interrupt handler at each tick. */
+void
+workqueue_tick (int64_t now)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (!list_empty (&delayed_list))
+    {
+      struct work *w = list_entry (list_front (&delayed_list),
+                                   struct work, elem);
+      if (w->wake_tick > now)
+        break;
+      list_pop_front (&delayed_list);
+      make_pending (w->wq, w);
+    }
+}
+
+/* Removes W from its queue or timer, if it is on one, and then
+   waits for any running instance of it to finish.  Returns true
+   if W was queued or delayed, false otherwise.  When called from
+   an interrupt handler, or by W's own function, does not wait. */
+bool
+work_cancel (struct work *w)
+{
+  enum intr_level old_level;
+  bool was_queued;
+
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  was_queued = w->state != WORK_IDLE;
+  if (was_queued)
+    {
+      /* The worker that would have taken W off the pending list
+         will find one item fewer there than it was promised by
+         the semaphore, and just go back to sleep. */
+      list_remove (&w->elem);
+      w->state = WORK_IDLE;
+    }
+  intr_set_level (old_level);
+
+  if (!intr_context () && w->wq != NULL)
+    wait_until (w->wq, w, work_idle);
+  return was_queued;
+}
+
+/* Waits until W is neither queued nor running.  If W is
+   delayed, it is queued immediately rather than waiting for its
+   timer.  W must have been queued at least once. */
+void
+work_flush (struct work *w)
+{
+  enum intr_level old_level;
+
+  ASSERT (w != NULL);
+  ASSERT (!intr_context ());
+
+  if (w->wq == NULL)
+    return;
+
+  old_level = intr_disable ();
+  if (w->state == WORK_DELAYED)
+    {
+      list_remove (&w->elem);
+      make_pending (w->wq, w);
+    }
+  intr_set_level (old_level);
+
+  wait_until (w->wq, w, work_idle);
+}
+
+/* Waits until WQ has no work queued and none running.  Work
+   that is still waiting on its timer is not waited for.  Work
+   queued while this function waits, for example by work items
+   that requeue themselves, delays its return. */
+void
+workqueue_flush (struct workqueue *wq)
+{
+  ASSERT (wq != NULL);
+  ASSERT (!intr_context ());
+
+  wait_until (wq, NULL, queue_idle);
+}
+
+/* Puts W on WQ's pending list and wakes a worker.
+   Interrupts must be off. */
+static void
+make_pending (struct workqueue *wq, struct work *w)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  w->wq = wq;
+  w->state = WORK_PENDING;
+  list_push_back (&wq->pending, &w->elem);
+  sema_up (&wq->ready);
+}
+
+/* Thread function for the worker W_. */
+static void
+worker_thread (void *w_)
+{
+  struct worker *w = w_;
+  struct workqueue *wq = w->wq;
+
+  w->thread = thread_current ();
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct work *work;
+      struct list_elem *e;
+
+      sema_down (&wq->ready);
+
+      old_level = intr_disable ();
+      if (list_empty (&wq->pending))
+        {
+          intr_set_level (old_level);
+          if (wq->dying)
+            break;
+          continue;
+        }
+      work = list_entry (list_pop_front (&wq->pending), struct work, elem);
+      work->state = WORK_IDLE;
+      w->current = work;
+      wq->busy_cnt++;
+      intr_set_level (old_level);
+
+      work->func (work);
+
+      old_level = intr_disable ();
+      w->current = NULL;
+      wq->busy_cnt--;
+      wq->done_cnt++;
+      for (e = list_begin (&wq->flushers); e != list_end (&wq->flushers);
+           e = list_next (e))
+        sema_up (&list_entry (e, struct flusher, elem)->sema);
+      intr_set_level (old_level);
+    }
+
+  sema_up (&wq->exited);
+}
+
+/* Blocks until DONE(WQ, W) returns true.  DONE is evaluated
+   with interrupts off, and again each time one of WQ's workers
+   finishes a work item. */
+static void
+wait_until (struct workqueue *wq, struct work *w,
+            bool (*done) (struct workqueue *, struct work *))
+{
+  struct flusher f;
+  enum intr_level old_level;
+
+  sema_init (&f.sema, 0);
+  old_level = intr_disable ();
+  list_push_back (&wq->flushers, &f.elem);
+  while (!done (wq, w))
+    sema_down (&f.sema);
+  list_remove (&f.elem);
+  intr_set_level (old_level);
+}
+
+/* Returns true if WQ has no pending or running work. */
+static bool
+queue_idle (struct workqueue *wq, struct work *w UNUSED)
+{
+  return list_empty (&wq->pending) && wq->busy_cnt == 0;
+}
+
+/* Returns true if W is not queued on WQ and no worker of WQ,
+   other than the running thread, is running it. */
+static bool
+work_idle (struct workqueue *wq, struct work *w)
+{
+  int i;
+
+  if (w->state == WORK_PENDING)
+    return false;
+  for (i = 0; i < wq->worker_cnt; i++)
+    if (wq->workers[i].current == w
+        && wq->workers[i].thread != thread_current ())
+      return false;
+  return true;
+}
+
+/* Orders work items by wake_tick, ascending. */
+static bool
+wake_tick_less (const struct list_elem *a_, const struct list_elem *b_,
+                void *aux UNUSED)
+{
+  const struct work *a = list_entry (a_, struct work, elem);
+  const struct work *b = list_entry (b_, struct work, elem);
+
+  return a->wake_tick < b->wake_tick;
+}
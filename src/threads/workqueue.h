@@ -0,0 +1,91 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+/* Work queues.
+
+   A work item is a function to be called later from a kernel
+   thread, outside the context that asked for it.  Each work
+   queue owns one or more worker threads that pull items off
+   the queue in FIFO order and run them.  Work may be queued
+   from an interrupt handler, which makes work queues a
+   convenient place to put the "bottom half" of an interrupt:
+   the part that may sleep, take locks, or simply takes too
+   long to do with interrupts off.
+
+   Work can also be delayed: workqueue_queue_delayed() puts
+   the item on a timer list and the timer interrupt moves it to
+   its queue once the delay has passed. */
+
+struct work;
+struct worker;
+typedef void work_func (struct work *);
+
+/* Where a work item currently is. */
+enum work_state
+  {
+    WORK_IDLE,                  /* Not queued. */
+    WORK_DELAYED,               /* Waiting for its timer to expire. */
+    WORK_PENDING                /* On its queue, waiting for a worker. */
+  };
+
+/* A work item.
+   Usually embedded in a larger structure; the function can use
+   work_entry() to get back to it.  The
+   function may free the item or queue it again: the worker
+   does not touch it once the function has been called. */
+struct work
+  {
+    struct list_elem elem;      /* Element in pending or timer list. */
+    work_func *func;            /* Function to call. */
+    struct workqueue *wq;       /* Queue it was last put on. */
+    enum work_state state;      /* Current state. */
+    int64_t wake_tick;          /* When delayed work becomes pending. */
+  };
+
+/* Converts pointer to work item WORK into a pointer to the
+   structure that WORK is embedded inside.  Supply the name of
+   the outer structure STRUCT and the member name MEMBER of the
+   work item. */
+#define work_entry(WORK, STRUCT, MEMBER)                        \
+        ((STRUCT *) ((uint8_t *) &(WORK)->func                  \
+                     - offsetof (STRUCT, MEMBER.func)))
+
+/* A work queue. */
+struct workqueue
+  {
+    char name[16];              /* Name, for debugging. */
+    struct list pending;        /* Work ready to run. */
+    struct semaphore ready;     /* One "up" per pending item. */
+    struct worker *workers;     /* Worker threads. */
+    int worker_cnt;             /* Number of worker threads. */
+    int busy_cnt;               /* Workers currently running work. */
+    bool dying;                 /* Set by workqueue_destroy(). */
+    struct semaphore exited;    /* Up'd by each worker as it exits. */
+    struct list flushers;       /* Threads waiting for the queue to idle. */
+    unsigned long long done_cnt; /* Number of work items run. */
+  };
+
+/* Queue shared by code that does not need its own. */
+extern struct workqueue *system_wq;
+
+void workqueue_init (void);
+struct workqueue *workqueue_create (const char *name, int priority,
+                                    int worker_cnt);
+void workqueue_destroy (struct workqueue *);
+void workqueue_flush (struct workqueue *);
+void workqueue_tick (int64_t now);
+
+void work_init (struct work *, work_func *);
+bool workqueue_queue (struct workqueue *, struct work *);
+bool workqueue_queue_delayed (struct workqueue *, struct work *,
+                              int64_t ticks);
+bool work_cancel (struct work *);
+void work_flush (struct work *);
+
+#endif /* threads/workqueue.h */
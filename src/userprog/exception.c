@@ -6,6 +6,7 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "vm/frametable.h"
 #include "vm/spagetable.h"
 #include "vm/swaptable.h"
 
@@ -159,9 +160,6 @@ page_fault (struct intr_frame *f)
   user = (f->error_code & PF_U) != 0;
 
   lock_acquire (&memory_master_lock);
-  uint8_t *kpage = assign_page ();
-  if (kpage == NULL)
-    PANIC("assign_page page failed while loading from file");
 
   /* Implementation of demand paging */
   /* Eddy and Andrew drove here */
@@ -181,7 +179,7 @@ page_fault (struct intr_frame *f)
   if(isstackaccess && spage_info == NULL) 
     {
       struct spinfo * new_spinfo;
-      new_spinfo = malloc (sizeof (struct spinfo));
+      new_spinfo = spinfo_alloc ();
       new_spinfo->file = NULL;
       new_spinfo->bytes_to_read = 0;
       new_spinfo->writable = true;
@@ -208,6 +206,12 @@ page_fault (struct intr_frame *f)
       thread_exit ();
     }
 
+  /* Only take a frame once the access is known to be good, since
+     the frame comes back pinned and the paths above never return. */
+  uint8_t *kpage = assign_page ();
+  if (kpage == NULL)
+    PANIC("assign_page page failed while loading from file");
+
   /* Radu drove here */
   struct metaswap_entry* freed_metaswap_entry = NULL;
 
@@ -242,6 +246,7 @@ page_fault (struct intr_frame *f)
   else 
     {
       spage_info->kpage_address = kpage;
+      unpin_frame (kpage);
       if (freed_metaswap_entry != NULL)
         {
           pagedir_set_dirty (thread_current ()->pagedir, spage_info->upage_address, freed_metaswap_entry->isdirty);
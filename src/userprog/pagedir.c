@@ -12,11 +12,12 @@ static void invalidate_pagedir (uint32_t *);
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
    Returns the new page directory, or a null pointer if memory
-   allocation fails. */
+   allocation fails.  May block to evict user pages to make
+   room. */
 uint32_t *
 pagedir_create (void) 
 {
-  uint32_t *pd = palloc_get_page (0);
+  uint32_t *pd = palloc_get_page (PAL_RECLAIM);
   if (pd != NULL)
     memcpy (pd, init_page_dir, PGSIZE);
   return pd;
@@ -52,20 +52,24 @@ process_execute (const char *file_name)
     return TID_ERROR;
   strlcpy (fn_copy, file_name, PGSIZE);
 
+  /* Eddy drove here */
+  // reset before the child exists, since it may finish loading
+  // before we run again
+  thread_current ()->childExecSuccess = false;
+
   /* Create a new thread to execute FILE_NAME. */
   // we're changing the name to just the executable path in load()
   tid = thread_create (file_name, PRI_DEFAULT, start_process, fn_copy);
+  if (tid == TID_ERROR)
+    {
+      free (fn_copy);
+      return TID_ERROR;
+    }
 
-  /* Eddy drove here */
-  thread_current ()->childExecSuccess = false;
   sema_down (&thread_current ()->exec_sema);
 
   if (!thread_current ()->childExecSuccess)
     return TID_ERROR;
-  
-  if (tid == TID_ERROR) {
-    free_frame (fn_copy); 
-  }
 
   return tid;
 }
@@ -130,7 +134,7 @@ process_wait (tid_t child_tid)
           
           //remove the status_holder (reap the child)
           list_remove(&s_holder->child_elem);
-          palloc_free_page((void*) s_holder);
+          slab_free (&status_holder_cache, s_holder);
 
           return number_status;
         }
@@ -476,7 +480,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       lock_acquire(&memory_master_lock);
       /* Make an entry in the supplemental page table. */
       struct spinfo * new_spinfo;
-      new_spinfo = malloc(sizeof (struct spinfo));
+      new_spinfo = spinfo_alloc ();
       new_spinfo->file = file;
       new_spinfo->file_offset = ofs;
       new_spinfo->bytes_to_read = page_read_bytes;
@@ -509,7 +513,7 @@ setup_stack (void **esp, char * argv[], int argc)
   
   /* Make an entry in the supplemental page table for the stack. */
   struct spinfo * new_spinfo;
-  new_spinfo = malloc(sizeof (struct spinfo));
+  new_spinfo = spinfo_alloc ();
   new_spinfo->file = NULL;
   new_spinfo->bytes_to_read = 0;
   new_spinfo->writable = true;
@@ -524,7 +528,10 @@ setup_stack (void **esp, char * argv[], int argc)
     {
       bool success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
       if (success)
-        *esp = PHYS_BASE;
+        {
+          *esp = PHYS_BASE;
+          unpin_frame (kpage);
+        }
       else {
         free_frame (kpage);
         palloc_free_page (kpage);
@@ -6,6 +6,7 @@
 #include "filesys/filesys.h"
 #include "filesys/file.h"
 #include "filesys/fsutil.h"
+#include "filesys/inode.h"
 #include "userprog/process.h"
 #include "threads/vaddr.h"
 #include "devices/input.h"
@@ -32,6 +33,13 @@ int write_h (int file_descriptor, void *buffer, unsigned size);
 int seek_h (int file_descriptor, unsigned position);
 unsigned tell_h (int file_descriptor);
 int close_h (int file_descriptor);
+bool fsync_h (int file_descriptor);
+void sync_h (void);
+bool chdir_h (char *dir);
+bool mkdir_h (char *dir);
+bool readdir_h (int file_descriptor, char *name);
+bool isdir_h (int file_descriptor);
+int inumber_h (int file_descriptor);
 
 // checks the validity of a pointer
 void check_pointer (void *pointer);
@@ -56,16 +64,12 @@ void assign_fd(struct file *open_file, struct file * files[]);
 // prototype to pintos shutdown function - this was placed here to silence a warning.
 void shutdown_power_off(void);
 
-/* lock to synchronize access to the filesystem */
-static struct lock syscall_lock;
-
 extern struct lock memory_master_lock;
 
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
-  lock_init (&syscall_lock);
 }
 
 static void
@@ -184,6 +188,53 @@ syscall_handler (struct intr_frame *f UNUSED)
 	  			f->eax = close_h (file_descriptor);
 	  		}
 	  	break;
+	  	case SYS_FSYNC:
+	  		{
+	  			check_pointer (esp_int_pointer+1);
+	  			int file_descriptor = (int) *(esp_int_pointer+1);
+	  			f->eax = fsync_h (file_descriptor);
+	  		}
+	  	break;
+	  	case SYS_SYNC:
+	  		sync_h ();
+	  	break;
+	  	case SYS_CHDIR:
+	  		{
+	  			check_pointer (esp_int_pointer+1);
+	  			char **dir = (char **) (esp_int_pointer+1);
+	  			f->eax = chdir_h (*dir);
+	  		}
+	  	break;
+	  	case SYS_MKDIR:
+	  		{
+	  			check_pointer (esp_int_pointer+1);
+	  			char **dir = (char **) (esp_int_pointer+1);
+	  			f->eax = mkdir_h (*dir);
+	  		}
+	  	break;
+	  	case SYS_READDIR:
+	  		{
+	  			check_pointer (esp_int_pointer+1);
+	  			check_pointer (esp_int_pointer+2);
+	  			int file_descriptor = (int) *(esp_int_pointer+1);
+	  			char **name = (char **) (esp_int_pointer+2);
+	  			f->eax = readdir_h (file_descriptor, *name);
+	  		}
+	  	break;
+	  	case SYS_ISDIR:
+	  		{
+	  			check_pointer (esp_int_pointer+1);
+	  			int file_descriptor = (int) *(esp_int_pointer+1);
+	  			f->eax = isdir_h (file_descriptor);
+	  		}
+	  	break;
+	  	case SYS_INUMBER:
+	  		{
+	  			check_pointer (esp_int_pointer+1);
+	  			int file_descriptor = (int) *(esp_int_pointer+1);
+	  			f->eax = inumber_h (file_descriptor);
+	  		}
+	  	break;
   }
 }
 
@@ -208,11 +259,9 @@ tid_t
 exec_h (char *cmd_line)
 {
 	check_pointer (cmd_line);
-	lock_acquire (&syscall_lock);
-	tid_t tid = process_execute (cmd_line);
-	lock_release (&syscall_lock);
-
-	return tid;
+	// the file system does its own locking, so the child loads
+	// while other processes keep doing file I/O
+	return process_execute (cmd_line);
 }
 
 int
@@ -226,9 +275,7 @@ create_h (char *file, unsigned initial_size)
 {
 	check_pointer (file);
 	bool success = false;
-	lock_acquire (&syscall_lock);
 	success = filesys_create (file, (off_t) initial_size);
-	lock_release (&syscall_lock);
 
 	return success;
 }
@@ -238,9 +285,7 @@ bool
 remove_h (char *file)
 {
 	check_pointer (file);
-	lock_acquire (&syscall_lock);
 	bool success = filesys_remove (file);
-	lock_release (&syscall_lock);
 	return success;
 }
 
@@ -248,9 +293,7 @@ int
 open_h (char *file)
 {
 	check_pointer (file);
-	lock_acquire (&syscall_lock);
 	struct file *open_file = filesys_open (file);
-	lock_release (&syscall_lock);
 	if (open_file == NULL)
 		return -1;
 	assign_fd (open_file, thread_current () -> open_files);
@@ -291,9 +334,7 @@ read_h (int file_descriptor, void *buffer, unsigned size)
 			struct file *found_file = find_open_file (file_descriptor);
 			if (found_file != NULL) 
 			{
-				lock_acquire (&syscall_lock);
 				bytes_read = file_read (found_file, buffer, size);
-				lock_release (&syscall_lock);
 			}
 			return bytes_read;
 		}
@@ -312,11 +353,10 @@ write_h (int file_descriptor, void *buffer, unsigned size)
 		{
 			int bytes_written = -1;
 			struct file *found_file = find_open_file (file_descriptor);
-			if (found_file != NULL)
+			// directories are only changed through mkdir and remove
+			if (found_file != NULL && !inode_is_dir (file_get_inode (found_file)))
 				{
-					lock_acquire (&syscall_lock);
 					bytes_written = file_write (found_file, buffer, size);
-					lock_release (&syscall_lock);
 				}
 			return bytes_written;
 		}
@@ -329,9 +369,7 @@ seek_h (int file_descriptor, unsigned position)
 	struct file *found_file = find_open_file (file_descriptor);
 	if (found_file != NULL)
 		{
-			lock_acquire (&syscall_lock);
 			file_seek (found_file, (off_t) position);
-			lock_release (&syscall_lock);
 			return 1; //returning 1 and -1 to signify pushing to EAX
 		}
 	return -1;
@@ -343,9 +381,7 @@ tell_h (int file_descriptor)
 	struct file *found_file = find_open_file (file_descriptor);
 	if (found_file != NULL)
 		{
-			lock_acquire (&syscall_lock);
 			unsigned ret =  (unsigned) file_tell (found_file);
-			lock_release (&syscall_lock);
 			return ret;
 		}
 	return -1;
@@ -363,6 +399,71 @@ close_h (int file_descriptor)
 	return 1;
 }
 
+/* Writes the file's dirty data to disk before returning. */
+bool
+fsync_h (int file_descriptor)
+{
+	struct file *found_file = find_open_file (file_descriptor);
+	if (found_file == NULL)
+		return false;
+	file_sync (found_file);
+	return true;
+}
+
+/* Writes all dirty file system data to disk before returning. */
+void
+sync_h (void)
+{
+	filesys_sync ();
+}
+
+/* Changes the process's working directory. */
+bool
+chdir_h (char *dir)
+{
+	check_pointer (dir);
+	bool success = filesys_chdir (dir);
+	return success;
+}
+
+bool
+mkdir_h (char *dir)
+{
+	check_pointer (dir);
+	bool success = filesys_mkdir (dir);
+	return success;
+}
+
+/* Reads the next entry of an open directory into name, which
+   must have room for READDIR_MAX_LEN + 1 bytes. */
+bool
+readdir_h (int file_descriptor, char *name)
+{
+	check_pointer (name);
+	check_pointer (name + NAME_MAX);
+	struct file *found_file = find_open_file (file_descriptor);
+	if (found_file == NULL)
+		return false;
+	bool success = file_readdir (found_file, name);
+	return success;
+}
+
+bool
+isdir_h (int file_descriptor)
+{
+	struct file *found_file = find_open_file (file_descriptor);
+	return found_file != NULL && inode_is_dir (file_get_inode (found_file));
+}
+
+int
+inumber_h (int file_descriptor)
+{
+	struct file *found_file = find_open_file (file_descriptor);
+	if (found_file == NULL)
+		return -1;
+	return inode_get_inumber (file_get_inode (found_file));
+}
+
 struct file *
 find_open_file (int fd) 
 {
@@ -382,15 +483,10 @@ check_pointer (void *pointer)
 	//check above phys base			check within its own page
 	if(is_kernel_vaddr (pointer) || pagedir_get_page (thread_current ()->pagedir, pointer) == NULL) {
 		bool is_stack_access = (pointer < PHYS_BASE && pointer >= thread_current()->personal_esp) || thread_current()->personal_esp - 0x20 == pointer || thread_current()->personal_esp - 0x04 == pointer;
-		lock_acquire(&memory_master_lock);
-		struct spinfo * target_spinfo = find_spinfo(&thread_current()->spage_table, pg_round_down(pointer));
-		if (!is_stack_access && target_spinfo == NULL)
+		bool has_spinfo = spinfo_present (&thread_current ()->spage_table, pg_round_down (pointer));
+		if (!is_stack_access && !has_spinfo)
 		// Quit only if it isn't an invalid stack access.
-		{
-			lock_release(&memory_master_lock);
 			exit_h (-1);
-		}
-		lock_release(&memory_master_lock);
 	}
 	//exit_h will handle freeing the page and closing the process
 }
@@ -2,33 +2,38 @@
 #include "threads/palloc.h"
 #include "vm/swaptable.h"
 #include <inttypes.h>
+#include "threads/synch.h"
 #include "threads/vaddr.h"
 
-int num_user_frames;
+extern struct lock memory_master_lock;
+
+/* The frame table has one entry per physical page of RAM, indexed
+   by physical page number, so that it grows and shrinks along with
+   the number of user pages the page allocator hands out instead of
+   being sized for a fixed share of memory. */
+uint32_t num_frames;
 struct metaframe * frametable; 
 
+/* Number of entries in the frame table that are filled. */
+uint32_t num_pages_assigned = 0;
+
 uint32_t clock_hand = 0;
 
-int num_pages_assigned = 0;
+static bool evict_page (void);
+static size_t reclaim_frames (size_t page_cnt);
 
 /* Andrew and Radu drove here */
 void
 init_frametable(uint32_t init_ram_pages)
 {
-	/* Free memory starts at 1 MB and runs to the end of RAM. */
-  uint8_t *free_start = ptov (1024 * 1024);
-  uint8_t *free_end = ptov (init_ram_pages * PGSIZE);
-  size_t free_pages = (free_end - free_start) / PGSIZE;
-  size_t user_pages = free_pages / 2;
-
-	num_user_frames = user_pages - 1;
-	frametable = calloc (sizeof(struct metaframe), num_user_frames);
-	int i;
-	for(i = 0; i < num_user_frames; i++) 
-		{
-			frametable[i].page = NULL;
-			frametable[i].isfilled = false;
-		}
+	num_frames = init_ram_pages;
+	frametable = calloc (sizeof(struct metaframe), num_frames);
+	if (frametable == NULL)
+		PANIC ("could not allocate frame table");
+
+	/* Let the page allocator take user pages back when the kernel
+	   runs short of memory. */
+	palloc_set_reclaim (reclaim_frames);
 }
 
 struct metaframe* 
@@ -36,56 +41,81 @@ get_metaframe_bypage(void* page)
 {// not locking because its calling function already locks
 	if(page == NULL)
 		PANIC("Page in get metaframe by page == NULL");
-	int i;
-	for(i = 0; i < num_user_frames; i++)
-		{
-			if(frametable[i].page == page)
-				{
-					return &frametable[i];
-				}
-		}
-	return NULL;
-}
-
-struct metaframe* 
-next_empty_frame()
-{
-	int i;
-	for(i=0; i<num_user_frames; i++)
-	{
-		if(!frametable[i].isfilled)
-		 {
-		 		return &frametable[i];
-		 }
-	}
-
-	return evict_page();
+	struct metaframe *frame = &frametable[vtop (page) >> PGBITS];
+	return frame->page == page ? frame : NULL;
 }
 
+/* Gets a user page from the page allocator, evicting pages when
+   it has none to give, and records it in the frame table.
+   The page is pinned, so that it is not evicted while it is
+   being filled in; the caller unpins it with unpin_frame() once
+   it is mapped.  The caller must hold memory_master_lock. */
 void* 
 assign_page()
 {
-	struct metaframe* new_frame = next_empty_frame ();
 	void* new_page = palloc_get_page (PAL_USER | PAL_ZERO);
+	while (new_page == NULL)
+		{
+			if (!evict_page ())
+				return NULL;
+			new_page = palloc_get_page (PAL_USER | PAL_ZERO);
+		}
+
+	struct metaframe* new_frame = &frametable[vtop (new_page) >> PGBITS];
 	new_frame->page = new_page;
 	new_frame->isfilled = true;
 	num_pages_assigned++;
 	new_frame->owner = thread_current ();
+	new_frame->pinned = true;
 
 	return new_page;
 }
 
+void
+unpin_frame (void* page)
+{
+	struct metaframe* frame = get_metaframe_bypage (page);
+	if (frame != NULL)
+		frame->pinned = false;
+}
+
 void
 free_frame (void* page)
 {
 	struct metaframe* frame2free = get_metaframe_bypage (page);
+	if (frame2free == NULL || !frame2free->isfilled)
+		return;
 	frame2free->page = NULL;
 	frame2free->owner = NULL;
 	frame2free->isfilled = false;
+	frame2free->pinned = false;
+	num_pages_assigned--;
+}
+
+/* Evicts up to PAGE_CNT user pages for the page allocator and
+   returns the number evicted.  Only called from the background
+   reclaim work and from kernel allocations that asked to block.
+   Nothing is evicted if the running thread is in the middle of
+   changing the frame table itself. */
+static size_t
+reclaim_frames (size_t page_cnt)
+{
+	size_t evicted = 0;
+
+	if (lock_held_by_current_thread (&memory_master_lock))
+		return 0;
+	lock_acquire (&memory_master_lock);
+
+	while (evicted < page_cnt && evict_page ())
+		evicted++;
+
+	lock_release (&memory_master_lock);
+	return evicted;
 }
 
 // Implement page eviction using the clock algorithm
-static struct metaframe*
+// Returns false if there is no page to evict
+static bool
 evict_page ()// change to do while loop because owner_of_frame changes every time, so lock changes
 {
 	struct thread * owner_of_frame;
@@ -93,12 +123,26 @@ evict_page ()// change to do while loop because owner_of_frame changes every tim
 	struct spinfo * current_spinfo;
 	void * current_page;
 	bool is_accessed_bit_set;
+	uint32_t skipped;
+
+	if (num_pages_assigned == 0)
+		return false;
 
 	do
 		{
-			clock_hand++;
-			if (clock_hand >= num_user_frames)
-				clock_hand = 0;// move the clock_hand back to the start
+			/* Skip over frames that are not user pages, and pinned
+			   frames, which are still being filled in.  If a whole
+			   sweep turns up nothing else, every page is pinned. */
+			skipped = 0;
+			do
+				{
+					if (skipped++ > num_frames)
+						return false;
+					clock_hand++;
+					if (clock_hand >= num_frames)
+						clock_hand = 0;// move the clock_hand back to the start
+				}
+			while (!frametable[clock_hand].isfilled || frametable[clock_hand].pinned);
 			
 			owner_of_frame = frametable[clock_hand].owner;
 			current_kpage = frametable[clock_hand].page;
@@ -121,9 +165,9 @@ evict_page ()// change to do while loop because owner_of_frame changes every tim
 
 	// evict the chosen page from the frame
 	current_spinfo->kpage_address = NULL;//setting it to null just here would suffice because in all other locations the spinfo is freed.
-	palloc_free_page (current_kpage);//freeing the page because it becomes garbage after this
 	free_frame (current_kpage);
+	palloc_free_page (current_kpage);//freeing the page because it becomes garbage after this
 
-	return &frametable[clock_hand];
+	return true;
 }
 
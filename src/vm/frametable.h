@@ -13,18 +13,17 @@ struct metaframe
 	bool isfilled; 									/* Is this entry in the frame table occupied by a page or not? */
 	void *page;											/* Pointer to the page that occupies this frame */
 	struct thread * owner;					/* Owner of the page that occupies this frame */
+	bool pinned;										/* Being filled in, so not to be evicted */
 };
 //dynamically allocate memory for the frame table
 void init_frametable(uint32_t init_ram_pages);
 //get a metaframe in the table by page
 struct metaframe* get_metaframe_bypage(void* page);
-//get the next available metaframe within the frame table
-struct metaframe* next_empty_frame(void);
-//assign a page for the frame
+//assign a page for the frame, evicting another if needed
 void* assign_page(void);
+//let a frame from assign_page be evicted once it is mapped
+void unpin_frame(void* page);
 //free up a frame
 void free_frame(void* page);
-//evict a page
-static struct metaframe*evict_page(void);
 
 #endif /* vm/frametable.h */
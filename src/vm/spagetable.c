@@ -1,7 +1,31 @@
 #include "spagetable.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "vm/swaptable.h"
+
+/* Supplemental page table entries. */
+static struct slab_cache spinfo_cache;
+
+/* Initializes the supplemental page table module. */
+void
+spagetable_init (void)
+{
+  slab_cache_init (&spinfo_cache, "spinfo", sizeof (struct spinfo), NULL);
+}
+
+/* Allocates a supplemental page table entry.  Returns a null
+   pointer if memory is not available.  Entries are freed by
+   spagetable_destroy(). */
+struct spinfo *
+spinfo_alloc (void)
+{
+  return slab_alloc (&spinfo_cache);
+}
 
 /* Andrew and Eddy drove here */
-/* Find the supplemental page info in the supplemental page table */
+/* Find the supplemental page info in the supplemental page table.
+   The caller must hold memory_master_lock so the entry cannot be
+   freed while it is in use. */
 struct spinfo * find_spinfo (struct list * info_list, uint8_t * page)
 {
   struct list_elem * e;
@@ -14,3 +38,46 @@ struct spinfo * find_spinfo (struct list * info_list, uint8_t * page)
     }
     return NULL;
 }
+
+/* Find the supplemental page info for the page that currently
+   lives in frame KPAGE.  Used by the evictor, which walks other
+   threads' tables; the caller must hold memory_master_lock. */
+struct spinfo * find_spinfo_by_kpage (struct list * info_list, uint8_t * kpage)
+{
+  struct list_elem * e;
+  for (e = list_begin (info_list);
+         e != list_end (info_list); e = list_next (e))
+    {
+      struct spinfo *spage_info = list_entry (e, struct spinfo, sptable_elem);
+      if (spage_info->kpage_address == kpage)
+        return spage_info;
+    }
+    return NULL;
+}
+
+/* Returns true if INFO_LIST, which must be the running thread's
+   own table, has an entry for user page PAGE.  Only the owning
+   thread adds or removes entries, so it can look without taking
+   memory_master_lock, which keeps this cheap enough for
+   validating every system call argument. */
+bool spinfo_present (struct list * info_list, uint8_t * page)
+{
+  ASSERT (info_list == &thread_current ()->spage_table);
+  return find_spinfo (info_list, page) != NULL;
+}
+
+/* Removes every entry of INFO_LIST, releasing their swap slots,
+   and frees them.  The caller must hold memory_master_lock, so
+   that the evictor is not walking the list. */
+void spagetable_destroy (struct list * info_list)
+{
+  while (!list_empty (info_list))
+    {
+      struct spinfo *spage_info = list_entry (list_pop_front (info_list),
+                                              struct spinfo, sptable_elem);
+
+      if (spage_info->instructions == SWAP)
+        free_metaswap_entry (spage_info->index_into_swap);
+      slab_free (&spinfo_cache, spage_info);
+    }
+}
@@ -33,6 +33,11 @@ struct spinfo
 	int index_into_swap;				/* an index into the block in swapspace which contains this page */
 };
 
+void spagetable_init (void);
+struct spinfo *spinfo_alloc (void);
 struct spinfo * find_spinfo (struct list * info_list, uint8_t * page);
+struct spinfo * find_spinfo_by_kpage (struct list * info_list, uint8_t * kpage);
+bool spinfo_present (struct list * info_list, uint8_t * page);
+void spagetable_destroy (struct list * info_list);
 
 #endif /* vm/spagetable.h */
@@ -61,13 +61,9 @@ move_into_swap(void* page, enum load_instruction instruction, bool isdirty)
 	if(new_swap_entry==NULL)
 		PANIC("no empty swap entries available");
 
-	char * buffer = (char*) page;
-	int i;
-	for(i = 0; i < 8; i++)
-		{
-			block_write(swap_block, 8 * new_swap_entry->swap_index + i, buffer);
-			buffer += BLOCK_SECTOR_SIZE;
-		}
+	// the page's 8 sectors go to disk in a single request
+	struct block_iovec iov = {page, 8};
+	block_writev(swap_block, 8 * new_swap_entry->swap_index, &iov, 1);
 	new_swap_entry->isfilled = true;
 	new_swap_entry->instructions_for_pageheld = instruction;
 	new_swap_entry->isdirty = isdirty;
@@ -80,13 +76,8 @@ read_from_swap(int index, void *page)
 	ASSERT(index != -1);
 	if(page == NULL)
 		PANIC("Page in read_from_swap == NULL");
-	char * buffer = (char*) page;
-	int i;
-	for(i = 0; i < 8; i++)
-		{
-			block_read(swap_block, 8 * index + i, buffer);
-			buffer += BLOCK_SECTOR_SIZE;
-		}
+	struct block_iovec iov = {page, 8};
+	block_readv(swap_block, 8 * index, &iov, 1);
 }
 
 struct metaswap_entry*